@@ -9,6 +9,10 @@ main()
 {
   char buf[64];
 
+  // when both are files, the kernel can copy without buf.
+  while(copy_file_range(0, 1, 4096) > 0)
+    ;
+
   while(1){
     int n = read(0, buf, sizeof(buf));
     if(n <= 0)
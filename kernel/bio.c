@@ -12,24 +12,36 @@
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
 //     so do not keep them longer than necessary.
+//
+// Most lookups find the block already cached, so they hold
+// bcache.lock only for reading, and take a reference with an
+// atomic add; every change to refcnt is atomic for that reason.
+// brelse() drops its reference with no lock at all: rather than
+// move the buffer to the front of a list, it stamps it with the
+// time, and bget() recycles the unused buffer with the oldest
+// stamp. Only bget() on a miss, which changes the block a buffer
+// holds, takes bcache.lock for writing.
 
 
 #include "types.h"
 #include "param.h"
 #include "spinlock.h"
 #include "sleeplock.h"
+#include "rwlock.h"
 #include "riscv.h"
 #include "defs.h"
+#include "proc.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 struct {
-  struct spinlock lock;
+  struct rwlock lock;
   struct buf buf[NBUF];
 
   // Linked list of all buffers, through prev/next.
-  // Sorted by how recently the buffer was used.
-  // head.next is most recent, head.prev is least.
+  // Sorted by how recently the buffer was recycled, since
+  // blocks just read in are the likeliest to be looked up.
   struct buf head;
 } bcache;
 
@@ -38,7 +50,7 @@ binit(void)
 {
   struct buf *b;
 
-  initlock(&bcache.lock, "bcache");
+  initrwlock(&bcache.lock, "bcache");
 
   // Create linked list of buffers
   bcache.head.prev = &bcache.head;
@@ -47,6 +59,7 @@ binit(void)
     b->next = bcache.head.next;
     b->prev = &bcache.head;
     initsleeplock(&b->lock, "buffer");
+    b->data = b->cache;
     bcache.head.next->prev = b;
     bcache.head.next = b;
   }
@@ -60,32 +73,59 @@ bget(uint dev, uint blockno)
 {
   struct buf *b;
 
-  acquire(&bcache.lock);
+  acquireread(&bcache.lock);
 
   // Is the block already cached?
   for(b = bcache.head.next; b != &bcache.head; b = b->next){
     if(b->dev == dev && b->blockno == blockno){
-      b->refcnt++;
-      release(&bcache.lock);
+      __sync_fetch_and_add(&b->refcnt, 1);
+      releaseread(&bcache.lock);
       acquiresleep(&b->lock);
       return b;
     }
   }
+  releaseread(&bcache.lock);
 
-  // Not cached.
-  // Recycle the least recently used (LRU) unused buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
+  acquirewrite(&bcache.lock);
+
+  // Look again: another bget() may have cached the block
+  // between the two acquires.
+  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+    if(b->dev == dev && b->blockno == blockno){
+      __sync_fetch_and_add(&b->refcnt, 1);
+      releasewrite(&bcache.lock);
       acquiresleep(&b->lock);
       return b;
     }
   }
-  panic("bget: no buffers");
+
+  // Not cached.
+  // Recycle the least recently used (LRU) unused buffer.
+  // refcnt can only rise from 0 in bget(), which we exclude,
+  // so a buffer seen unused here stays so.
+  struct buf *lru = 0;
+  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+    if(__atomic_load_n(&b->refcnt, __ATOMIC_ACQUIRE) == 0 &&
+       (lru == 0 || b->lastuse < lru->lastuse))
+      lru = b;
+  }
+  if(lru == 0)
+    panic("bget: no buffers");
+  b = lru;
+  b->dev = dev;
+  b->blockno = blockno;
+  b->valid = 0;
+  b->refcnt = 1;
+  // move it to the front, where lookups look first.
+  b->next->prev = b->prev;
+  b->prev->next = b->next;
+  b->next = bcache.head.next;
+  b->prev = &bcache.head;
+  bcache.head.next->prev = b;
+  bcache.head.next = b;
+  releasewrite(&bcache.lock);
+  acquiresleep(&b->lock);
+  return b;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -95,8 +135,15 @@ bread(uint dev, uint blockno)
   struct buf *b;
 
   b = bget(dev, blockno);
+  TRACE(TR_BREAD, blockno, b->valid);
   if(!b->valid) {
+    if(myproc())
+      myproc()->use.nbread++;
+#ifdef RAMDISK
+    ramdiskrw(b, 0);
+#else
     virtio_disk_rw(b, 0);
+#endif
     b->valid = 1;
   }
   return b;
@@ -108,11 +155,17 @@ bwrite(struct buf *b)
 {
   if(!holdingsleep(&b->lock))
     panic("bwrite");
+  TRACE(TR_BWRITE, b->blockno, 0);
+  if(myproc())
+    myproc()->use.nbwrite++;
+#ifdef RAMDISK
+  ramdiskrw(b, 1);
+#else
   virtio_disk_rw(b, 1);
+#endif
 }
 
-// Release a locked buffer.
-// Move to the head of the most-recently-used list.
+// Release a locked buffer, and note when it was last used.
 void
 brelse(struct buf *b)
 {
@@ -121,33 +174,19 @@ brelse(struct buf *b)
 
   releasesleep(&b->lock);
 
-  acquire(&bcache.lock);
-  b->refcnt--;
-  if (b->refcnt == 0) {
-    // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
-  }
-  
-  release(&bcache.lock);
+  // the stamp is only a hint, so racing brelse()s may
+  // both store it. store it before the reference goes,
+  // so that a bget() that sees refcnt 0 sees it too.
+  b->lastuse = r_time();
+  __atomic_sub_fetch(&b->refcnt, 1, __ATOMIC_RELEASE);
 }
 
 void
 bpin(struct buf *b) {
-  acquire(&bcache.lock);
-  b->refcnt++;
-  release(&bcache.lock);
+  __sync_fetch_and_add(&b->refcnt, 1);
 }
 
 void
 bunpin(struct buf *b) {
-  acquire(&bcache.lock);
-  b->refcnt--;
-  release(&bcache.lock);
+  __sync_fetch_and_sub(&b->refcnt, 1);
 }
-
-
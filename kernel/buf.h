@@ -5,8 +5,10 @@ struct buf {
   uint blockno;
   struct sleeplock lock;
   uint refcnt;
-  struct buf *prev; // LRU cache list
+  uint64 lastuse;   // time CSR at the last brelse(), for LRU
+  struct buf *prev; // cache list, most recently recycled first
   struct buf *next;
-  uchar data[BSIZE];
+  uchar *data;      // block contents: cache[], or the ramdisk block itself
+  uchar cache[BSIZE];
 };
 
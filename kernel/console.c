@@ -21,6 +21,7 @@
 #include "riscv.h"
 #include "defs.h"
 #include "proc.h"
+#include "poll.h"
 
 #define BACKSPACE 0x100
 #define C(x)  ((x)-'@')  // Control-x
@@ -50,6 +51,8 @@ struct {
   uint r;  // Read index
   uint w;  // Write index
   uint e;  // Edit index
+
+  struct pollent *pollq;  // poll() calls waiting for input
 } cons;
 
 //
@@ -126,6 +129,32 @@ consoleread(int user_dst, uint64 dst, int n)
   return target - n;
 }
 
+//
+// poll() on the console: input is ready once a whole
+// line has arrived, and output never blocks.
+//
+int
+consolepoll(int events, struct pollent *pe)
+{
+  int r = POLLOUT;
+
+  acquire(&cons.lock);
+  if(cons.r != cons.w)
+    r |= POLLIN;
+  if(pe)
+    pollwait(&cons.pollq, pe);
+  release(&cons.lock);
+  return r & events;
+}
+
+void
+consoleunpoll(struct pollent *pe)
+{
+  acquire(&cons.lock);
+  pollcancel(&cons.pollq, pe);
+  release(&cons.lock);
+}
+
 //
 // the console input interrupt handler.
 // uartintr() calls this for input character.
@@ -159,6 +188,7 @@ consoleintr(int c)
     cons.buf[cons.e++ % INPUT_BUF] = c;
     cons.w = cons.e;
     wakeup(&cons.r);
+    pollwakeup(&cons.pollq);
     break;
   default:
     if(c != 0 && cons.e-cons.r < INPUT_BUF){
@@ -175,6 +205,7 @@ consoleintr(int c)
         // has arrived.
         cons.w = cons.e;
         wakeup(&cons.r);
+        pollwakeup(&cons.pollq);
       }
     }
     break;
@@ -194,4 +225,6 @@ consoleinit(void)
   // to consoleread and consolewrite.
   devsw[CONSOLE].read = consoleread;
   devsw[CONSOLE].write = consolewrite;
+  devsw[CONSOLE].poll = consolepoll;
+  devsw[CONSOLE].unpoll = consoleunpoll;
 }
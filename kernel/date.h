@@ -6,3 +6,9 @@ struct rtcdate {
   uint month;
   uint year;
 };
+
+// for nanosleep() and clock_gettime().
+struct timespec {
+  uint64 sec;
+  uint64 nsec;   // 0 to 999999999
+};
@@ -3,11 +3,15 @@ struct context;
 struct file;
 struct inode;
 struct pipe;
+struct pollent;
 struct proc;
+struct vdso;
 struct spinlock;
 struct sleeplock;
+struct rwlock;
 struct stat;
 struct superblock;
+struct timer;
 
 // bio.c
 void            binit(void);
@@ -24,6 +28,7 @@ void            consputc(int);
 
 // exec.c
 int             exec(char*, char**);
+int             execinto(struct proc*, char*, char**);
 
 // file.c
 struct file*    filealloc(void);
@@ -33,6 +38,15 @@ void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
+int             filefcntl(struct file*, int, int);
+int             filesplice(struct file*, struct file*, int, int);
+int             filecopy(struct file*, struct file*, int);
+void            pollwait(struct pollent**, struct pollent*);
+void            pollcancel(struct pollent**, struct pollent*);
+void            pollwakeup(struct pollent**);
+int             filepoll(struct file*, int, struct pollent*);
+void            fileunpoll(struct file*, struct pollent*);
+int             poll(uint64, int, int);
 
 // fs.c
 void            fsinit(int);
@@ -56,8 +70,7 @@ void            itrunc(struct inode*);
 
 // ramdisk.c
 void            ramdiskinit(void);
-void            ramdiskintr(void);
-void            ramdiskrw(struct buf*);
+void            ramdiskrw(struct buf*, int);
 
 // kalloc.c
 void*           kalloc(void);
@@ -69,26 +82,54 @@ void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
 void            begin_op(void);
 void            end_op(void);
+void            begin_opn(int);
+void            end_opn(int);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
 int             pipewrite(struct pipe*, uint64, int);
+int             pipepoll(struct pipe*, int, int, struct pollent*);
+void            pipeunpoll(struct pipe*, struct pollent*);
+int             pipegetsize(struct pipe*);
+int             pipesetsize(struct pipe*, int);
+int             pipesplice(struct pipe*, struct pipe*, int, int);
+int             pipefill(struct pipe*, struct file*, int);
+int             pipedrain(struct pipe*, struct file*, int);
 
 // printf.c
 void            printf(char*, ...);
 void            panic(char*) __attribute__((noreturn));
 void            printfinit(void);
 
+// prof.c
+extern int      profiling;
+void            profinit(void);
+void            profkernel(uint64, uint64, uint64);
+void            profuser(struct proc*);
+int             prof(int, uint64, int);
+
 // proc.c
+extern struct vdso *vdso;
+extern int      boostpending;
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
+int             clone(uint64, uint64, uint64);
+int             spawn(char*, char**, int*, int);
+int             kthread(void (*)(void), char*);
+int             join(int);
+int             reapthread(int);
 int             growproc(int);
 void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
+void            rcubegin(void);
+void            rcuend(void);
+uint64          rcuretire(void);
+int             rcudone(uint64);
+void            rcuwait(uint64);
 int             kill(int);
 struct cpu*     mycpu(void);
 struct cpu*     getmycpu(void);
@@ -100,10 +141,21 @@ void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(uint64);
 void            wakeup(void*);
+int             perfstat(uint64, int);
+int             procstat(uint64, int);
+int             tlbstale(void);
+int             wakeupn(void*, int);
+int             futexwait(uint64, int);
+int             futexwake(uint64, int);
 void            yield(void);
+void            preempt(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+int             setpriority(int, int);
+int             getpriority(int);
+void            lendprio(struct proc*, struct sleeplock*, int);
+void            unlendprio(void);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -115,6 +167,16 @@ void            initlock(struct spinlock*, char*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
+int             lockstat(uint64, int, int);
+struct lockclass* findclass(char*);
+void            lockcount(struct lockclass*, int, uint64, int);
+
+// rwlock.c
+void            initrwlock(struct rwlock*, char*);
+void            acquireread(struct rwlock*);
+void            releaseread(struct rwlock*);
+void            acquirewrite(struct rwlock*);
+void            releasewrite(struct rwlock*);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
@@ -138,6 +200,22 @@ int             argaddr(int, uint64 *);
 int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
+int             sysstat(uint64, int, int);
+
+// ring.c
+int             ringsetup(uint64, int);
+int             ringenter(void);
+int             ringstop(void);
+
+// timer.c
+void            timerqinit(void);
+uint64          timenow(void);
+int             timerintr(void);
+void            timerstop(void);
+void            timerstart(void);
+int             timersleep(uint64);
+void            timeradd(struct timer*);
+void            timerdel(struct timer*);
 
 // trap.c
 extern uint     ticks;
@@ -145,6 +223,12 @@ void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
 void            usertrapret(void);
+void            ipi(int);
+
+// trace.c
+extern int      tracing;
+void            traceevent(int, uint64, uint64);
+int             trace(int, uint64, int);
 
 // uart.c
 void            uartinit(void);
@@ -154,6 +238,8 @@ void            uartputc_sync(int);
 int             uartgetc(void);
 
 // vm.c
+extern uint64   tlbgen;
+extern int      asids;
 void            kvminit(void);
 void            kvminithart(void);
 void            kvmmap(pagetable_t, uint64, uint64, uint64, int);
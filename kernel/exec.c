@@ -11,6 +11,27 @@ static int loadseg(pde_t *pgdir, uint64 addr, struct inode *ip, uint offset, uin
 
 int
 exec(char *path, char **argv)
+{
+  struct proc *p = myproc();
+  struct tgroup *tg = p->tg;
+  int others;
+
+  // other threads would be left running in the old image.
+  // a ring poller is stopped instead: its ring goes with it.
+  acquire(&tg->lock);
+  others = tg->ref - 1 - (tg->poller != 0);
+  release(&tg->lock);
+  if(others > 0 || ringstop() < 0 || tg->ref > 1)
+    return -1;
+
+  return execinto(p, path, argv);
+}
+
+// Replace p's user memory with the program at path, run with argv.
+// p is the caller, or a new process that has not run yet.
+// Returns argc, or -1 and leaves p as it was.
+int
+execinto(struct proc *p, char *path, char **argv)
 {
   char *s, *last;
   int i, off;
@@ -19,7 +40,6 @@ exec(char *path, char **argv)
   struct inode *ip;
   struct proghdr ph;
   pagetable_t pagetable = 0, oldpagetable;
-  struct proc *p = myproc();
 
   begin_op();
 
@@ -61,8 +81,7 @@ exec(char *path, char **argv)
   end_op();
   ip = 0;
 
-  p = myproc();
-  uint64 oldsz = p->sz;
+  uint64 oldsz = p->tg->sz;
 
   // Allocate two pages at the next page boundary.
   // Use the second as the user stack.
@@ -110,17 +129,22 @@ exec(char *path, char **argv)
     
   // Commit to the user image.
   oldpagetable = p->pagetable;
-  p->pagetable = pagetable;
-  p->sz = sz;
+  p->pagetable = p->tg->pagetable = pagetable;
+  p->tg->sz = sz;
+  p->tg->ring = 0;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
+  uvmunmap(oldpagetable, p->tfva, 1, 0);
+  p->tfva = TRAPFRAME;
   proc_freepagetable(oldpagetable, oldsz);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
 
  bad:
-  if(pagetable)
+  if(pagetable){
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
     proc_freepagetable(pagetable, sz);
+  }
   if(ip){
     iunlockput(ip);
     end_op();
@@ -12,6 +12,10 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "memlayout.h"
+#include "poll.h"
+#include "timer.h"
+#include "fcntl.h"
 
 struct devsw devsw[NDEV];
 struct {
@@ -180,3 +184,280 @@ filewrite(struct file *f, uint64 addr, int n)
   return ret;
 }
 
+// Is f a file or device that splice() can read or write?
+static int
+spliceable(struct file *f)
+{
+  if(f->type == FD_INODE)
+    return 1;
+  return f->type == FD_DEVICE && f->major >= 0 && f->major < NDEV &&
+         devsw[f->major].read && devsw[f->major].write;
+}
+
+// Move up to n bytes from in to out inside the kernel, where
+// at least one of them is a pipe. If tee, both are pipes and
+// the bytes stay in in as well.
+// Returns the number of bytes moved, 0 at end of file, or -1.
+int
+filesplice(struct file *in, struct file *out, int n, int tee)
+{
+  if(in->readable == 0 || out->writable == 0 || n < 0)
+    return -1;
+  if(in->type == FD_PIPE && out->type == FD_PIPE)
+    return pipesplice(in->pipe, out->pipe, n, tee);
+  if(tee)
+    return -1;
+  if(in->type == FD_PIPE && spliceable(out))
+    return pipedrain(in->pipe, out, n);
+  if(out->type == FD_PIPE && spliceable(in))
+    return pipefill(out->pipe, in, n);
+  return -1;
+}
+
+// Copy up to n bytes from file in to file out inside the
+// kernel, at and advancing both offsets. Each log transaction
+// reserves COPYOPBLOCKS blocks, so it carries more data than
+// filewrite()'s. Returns the number of bytes copied, 0 at end
+// of file, or -1.
+int
+filecopy(struct file *in, struct file *out, int n)
+{
+  // as in filewrite(), leaving room for the i-node, indirect
+  // and allocation blocks.
+  int max = ((COPYOPBLOCKS-1-1-2) / 2) * BSIZE;
+  int done = 0, err = 0, m, r, w;
+  char *buf;
+
+  if(in->readable == 0 || out->writable == 0 || n < 0)
+    return -1;
+  if(in->type != FD_INODE || out->type != FD_INODE)
+    return -1;
+  if((buf = kalloc()) == 0)
+    return -1;
+
+  while(done < n && !err){
+    begin_opn(COPYOPBLOCKS);
+    for(int i = 0; i < max && done < n; i += r){
+      m = n - done;
+      if(m > max - i)
+        m = max - i;
+      if(m > PGSIZE)
+        m = PGSIZE;
+      ilock(in->ip);
+      if((r = readi(in->ip, 0, (uint64)buf, in->off, m)) > 0)
+        in->off += r;
+      iunlock(in->ip);
+      if(r <= 0){
+        // end of file, or an error.
+        err = 1;
+        break;
+      }
+      ilock(out->ip);
+      if((w = writei(out->ip, 0, (uint64)buf, out->off, r)) > 0)
+        out->off += w;
+      iunlock(out->ip);
+      if(w != r){
+        err = 1;
+        break;
+      }
+      done += r;
+    }
+    end_opn(COPYOPBLOCKS);
+  }
+
+  kfree(buf);
+  return done;
+}
+
+// File control: get or set the size of a pipe's buffer.
+int
+filefcntl(struct file *f, int cmd, int arg)
+{
+  if(f->type != FD_PIPE)
+    return -1;
+  switch(cmd){
+  case F_GETPIPE_SZ:
+    return pipegetsize(f->pipe);
+  case F_SETPIPE_SZ:
+    return pipesetsize(f->pipe, arg);
+  }
+  return -1;
+}
+
+
+// Put pe on the wait queue *q of an object that poll() waits
+// for, whose lock the caller holds.
+void
+pollwait(struct pollent **q, struct pollent *pe)
+{
+  pe->next = *q;
+  *q = pe;
+}
+
+// Take pe off the wait queue *q; the caller holds its lock.
+void
+pollcancel(struct pollent **q, struct pollent *pe)
+{
+  struct pollent **pp;
+
+  for(pp = q; *pp; pp = &(*pp)->next){
+    if(*pp == pe){
+      *pp = pe->next;
+      break;
+    }
+  }
+}
+
+// The object with wait queue *q has changed: wake the poll()
+// calls waiting for it. The caller holds the object's lock.
+void
+pollwakeup(struct pollent **q)
+{
+  for(struct pollent *pe = *q; pe; pe = pe->next){
+    acquire(&pe->pt->lock);
+    pe->pt->woken = 1;
+    wakeup(pe->pt);
+    release(&pe->pt->lock);
+  }
+}
+
+// Which of events are ready on f, plus POLLERR and POLLHUP.
+// If pe is not 0, also put it on the wait queue of f's
+// object, until fileunpoll().
+int
+filepoll(struct file *f, int events, struct pollent *pe)
+{
+  int r = 0;
+
+  if(f->type == FD_PIPE)
+    return pipepoll(f->pipe, f->writable, events, pe);
+  if(f->type == FD_DEVICE && f->major >= 0 && f->major < NDEV && devsw[f->major].poll)
+    return devsw[f->major].poll(events, pe);
+  // files never block.
+  if(f->readable)
+    r |= POLLIN;
+  if(f->writable)
+    r |= POLLOUT;
+  return r & events;
+}
+
+// Take pe off the wait queue that filepoll() put it on.
+void
+fileunpoll(struct file *f, struct pollent *pe)
+{
+  if(f->type == FD_PIPE)
+    pipeunpoll(f->pipe, pe);
+  else if(f->type == FD_DEVICE && f->major >= 0 && f->major < NDEV && devsw[f->major].unpoll)
+    devsw[f->major].unpoll(pe);
+}
+
+// What poll() keeps for each struct pollfd, in one page.
+struct pollslot {
+  struct file *f;
+  struct pollent pe;
+  int fd;
+  short events;
+  short revents;
+};
+
+_Static_assert(NOFILE * sizeof(struct pollslot) <= PGSIZE,
+               "poll: NOFILE slots do not fit in a page");
+
+// Wait until one of the nfds struct pollfds at user address
+// ufds is ready, or until timeout milliseconds pass; forever
+// if timeout is negative. Sets each revents, and returns the
+// number of fds that are ready, or -1.
+int
+poll(uint64 ufds, int nfds, int timeout)
+{
+  struct proc *p = myproc();
+  struct tgroup *tg = p->tg;
+  struct polltable pt;
+  struct timer t;
+  struct pollfd pfd;
+  int i, n, expired = 0;
+  struct pollslot *slot;
+
+  if(nfds < 0 || nfds > NOFILE)
+    return -1;
+  if((slot = kalloc()) == 0)
+    return -1;
+
+  initlock(&pt.lock, "poll");
+  pt.woken = 0;
+  for(i = 0; i < nfds; i++){
+    if(copyin(p->pagetable, (char *)&pfd, ufds + i*sizeof(pfd), sizeof(pfd)) < 0){
+      while(--i >= 0)
+        if(slot[i].f)
+          fileclose(slot[i].f);
+      kfree(slot);
+      return -1;
+    }
+    slot[i].fd = pfd.fd;
+    slot[i].events = pfd.events;
+    slot[i].pe.pt = &pt;
+    // hold a reference, in case another thread closes fd.
+    slot[i].f = 0;
+    acquire(&tg->lock);
+    if(pfd.fd >= 0 && pfd.fd < NOFILE && tg->ofile[pfd.fd])
+      slot[i].f = filedup(tg->ofile[pfd.fd]);
+    release(&tg->lock);
+  }
+
+  if(timeout > 0){
+    t.when = timenow() + (uint64)timeout * (MTIME_HZ / 1000);
+    t.chan = &pt;
+    t.lk = &pt.lock;
+    timeradd(&t);
+  }
+
+  // scan the fds, the first time joining the wait queue of
+  // each one's object, until one is ready, or time is up.
+  for(int first = 1; ; first = 0){
+    acquire(&pt.lock);
+    pt.woken = 0;
+    release(&pt.lock);
+
+    n = 0;
+    for(i = 0; i < nfds; i++){
+      if(slot[i].fd < 0)
+        slot[i].revents = 0;
+      else if(slot[i].f == 0)
+        slot[i].revents = POLLNVAL;
+      else
+        slot[i].revents = filepoll(slot[i].f, slot[i].events, first ? &slot[i].pe : 0);
+      if(slot[i].revents)
+        n++;
+    }
+    if(n > 0 || timeout == 0 || expired)
+      break;
+
+    // the timer sets t.fired holding pt.lock; t.i is its
+    // heap's, under the heap's lock.
+    acquire(&pt.lock);
+    while(!pt.woken && !(timeout > 0 && t.fired) && !p->killed)
+      sleep(&pt, &pt.lock);
+    expired = (timeout > 0 && t.fired);
+    release(&pt.lock);
+    if(p->killed){
+      n = -1;
+      break;
+    }
+  }
+
+  if(timeout > 0)
+    timerdel(&t);
+  for(i = 0; i < nfds; i++){
+    if(slot[i].f){
+      fileunpoll(slot[i].f, &slot[i].pe);
+      fileclose(slot[i].f);
+    }
+    pfd.fd = slot[i].fd;
+    pfd.events = slot[i].events;
+    pfd.revents = slot[i].revents;
+    if(n >= 0 && copyout(p->pagetable, ufds + i*sizeof(pfd), (char *)&pfd, sizeof(pfd)) < 0)
+      n = -1;
+  }
+  kfree(slot);
+  return n;
+}
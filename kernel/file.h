@@ -18,6 +18,9 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *hnext; // Next in its itable hash bucket
+  int hashed;         // on a hash bucket list?
+  uint64 epoch;       // rcuretire() when taken off the list
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -29,10 +32,25 @@ struct inode {
   uint addrs[NDIRECT+1];
 };
 
+// a poll() call waiting for objects to change.
+struct polltable {
+  struct spinlock lock;
+  int woken;          // an object changed since the last scan
+};
+
+// one of a poll() call's fds on its object's wait queue,
+// a list that the object's lock protects.
+struct pollent {
+  struct polltable *pt;
+  struct pollent *next;
+};
+
 // map major device number to device functions.
 struct devsw {
   int (*read)(int, uint64, int);
   int (*write)(int, uint64, int);
+  int (*poll)(int, struct pollent*);   // see filepoll()
+  void (*unpoll)(struct pollent*);
 };
 
 extern struct devsw devsw[];
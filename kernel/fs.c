@@ -165,17 +165,49 @@ bfree(int dev, uint b)
 // The itable.lock spin-lock protects the allocation of itable
 // entries. Since ip->ref indicates whether an entry is free,
 // and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold itable.lock while using any of those fields.
+// holds, one must hold itable.lock while changing any of those
+// fields, or ip->ref from zero.
+//
+// iget() looks for an inode that is already in the table
+// without itable.lock: entries with ref > 0 are on hash lists
+// that it reads under rcubegin(), taking a reference with an
+// atomic increment that fails once ref has reached zero. So
+// ip->ref changes only atomically, and an entry that leaves
+// its list is not recycled until RCU says no lookup can still
+// see it (see rcudone() in proc.c).
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
+#define NINODEHASH 16
+
 struct {
   struct spinlock lock;
   struct inode inode[NINODE];
+  struct inode *hash[NINODEHASH];  // entries with ref > 0
 } itable;
 
+static struct inode**
+ihash(uint dev, uint inum)
+{
+  return &itable.hash[(dev * 31 + inum) % NINODEHASH];
+}
+
+// Take a reference to ip, unless its ref has already dropped
+// to zero, and it is on its way off the hash list.
+static int
+igetref(struct inode *ip)
+{
+  int ref;
+
+  do {
+    if((ref = __atomic_load_n(&ip->ref, __ATOMIC_RELAXED)) == 0)
+      return 0;
+  } while(!__sync_bool_compare_and_swap(&ip->ref, ref, ref + 1));
+  return 1;
+}
+
 void
 iinit()
 {
@@ -243,30 +275,60 @@ static struct inode*
 iget(uint dev, uint inum)
 {
   struct inode *ip, *empty;
+  uint64 epoch;
+
+  // Is the inode already in the table?
+  rcubegin();
+  for(ip = __atomic_load_n(ihash(dev, inum), __ATOMIC_ACQUIRE); ip;
+      ip = __atomic_load_n(&ip->hnext, __ATOMIC_ACQUIRE)){
+    if(ip->dev == dev && ip->inum == inum && igetref(ip)){
+      rcuend();
+      return ip;
+    }
+  }
+  rcuend();
 
+again:
   acquire(&itable.lock);
 
-  // Is the inode already in the table?
-  empty = 0;
-  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
+  // Look again: another iget() may have added it meanwhile.
+  for(ip = *ihash(dev, inum); ip; ip = ip->hnext){
+    if(ip->dev == dev && ip->inum == inum && igetref(ip)){
       release(&itable.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode entry.
-  if(empty == 0)
-    panic("iget: no inodes");
+  // Recycle an inode entry that no lookup can still see.
+  empty = 0;
+  epoch = 0;
+  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
+    if(ip->ref == 0 && !ip->hashed){
+      if(rcudone(ip->epoch)){
+        empty = ip;
+        break;
+      }
+      epoch = ip->epoch;
+    }
+  }
+
+  if(empty == 0){
+    if(epoch == 0)
+      panic("iget: no inodes");
+    // every free entry was on a hash list too recently.
+    release(&itable.lock);
+    rcuwait(epoch);
+    goto again;
+  }
 
   ip = empty;
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->hnext = *ihash(dev, inum);
+  ip->hashed = 1;
+  __atomic_store_n(ihash(dev, inum), ip, __ATOMIC_RELEASE);
   release(&itable.lock);
 
   return ip;
@@ -277,9 +339,7 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&itable.lock);
-  ip->ref++;
-  release(&itable.lock);
+  __sync_fetch_and_add(&ip->ref, 1);
   return ip;
 }
 
@@ -332,13 +392,17 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
+  struct inode **pp;
+
   acquire(&itable.lock);
 
   if(ip->ref == 1 && ip->valid && ip->nlink == 0){
     // inode has no links and no other references: truncate and free.
 
     // ip->ref == 1 means no other process can have ip locked,
-    // so this acquiresleep() won't block (or deadlock).
+    // so this acquiresleep() won't block (or deadlock). A
+    // lock-free iget() can't take a new reference either: with
+    // no links, nothing leads to this inum until it is freed.
     acquiresleep(&ip->lock);
 
     release(&itable.lock);
@@ -353,7 +417,18 @@ iput(struct inode *ip)
     acquire(&itable.lock);
   }
 
-  ip->ref--;
+  if(__sync_sub_and_fetch(&ip->ref, 1) == 0){
+    // off the hash list; lookups that are already looking at
+    // ip still see its hnext.
+    for(pp = ihash(ip->dev, ip->inum); *pp; pp = &(*pp)->hnext){
+      if(*pp == ip){
+        __atomic_store_n(pp, ip->hnext, __ATOMIC_RELEASE);
+        break;
+      }
+    }
+    ip->hashed = 0;
+    ip->epoch = rcuretire();
+  }
   release(&itable.lock);
 }
 
@@ -632,8 +707,12 @@ namex(char *path, int nameiparent, char *name)
 
   if(*path == '/')
     ip = iget(ROOTDEV, ROOTINO);
-  else
-    ip = idup(myproc()->cwd);
+  else {
+    struct tgroup *tg = myproc()->tg;
+    acquire(&tg->lock);
+    ip = idup(tg->cwd);
+    release(&tg->lock);
+  }
 
   while((path = skipelem(path, name)) != 0){
     ilock(ip);
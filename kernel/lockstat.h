@@ -0,0 +1,14 @@
+// Lock contention statistics, per lock name, as
+// copied out by the lockstat() system call.
+
+#define LOCKNAME 16
+
+struct lockstat {
+  char name[LOCKNAME];
+  uint64 nacquire;  // acquire() calls
+  uint64 ncontend;  // acquire() calls that found the lock held
+  uint64 nspin;     // time CSR cycles spent spinning for it
+  // sleep locks only, of the contended acquiresleep() calls:
+  uint64 nspinwin;  // those that got the lock by spinning
+  uint64 nsleep;    // those that had to sleep
+};
@@ -21,13 +21,19 @@ main()
     kvminithart();   // turn on paging
     procinit();      // process table
     trapinit();      // trap vectors
+    timerqinit();    // high-resolution timers
+    profinit();      // sampling profiler
     trapinithart();  // install kernel trap vector
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
     binit();         // buffer cache
     iinit();         // inode table
     fileinit();      // file table
+#ifdef RAMDISK
+    ramdiskinit();   // file system image linked into the kernel
+#else
     virtio_disk_init(); // emulated hard disk
+#endif
     userinit();      // first user process
     __sync_synchronize();
     started = 1;
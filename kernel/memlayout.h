@@ -27,8 +27,12 @@
 
 // core local interruptor (CLINT), which contains the timer.
 #define CLINT 0x2000000L
+#define CLINT_MSIP(hartid) (CLINT + 4*(hartid))
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
+#define MTIME_HZ 10000000L           // CLINT_MTIME cycles per second.
+#define NSPERCYCLE (1000000000L / MTIME_HZ)
+#define MTIME_NEVER 0xffffffffffffffffUL // a deadline that never comes.
 
 // qemu puts platform-level interrupt controller (PLIC) here.
 #define PLIC 0x0c000000L
@@ -62,6 +66,20 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   ...
+//   VDSOPROC (struct vdsoproc, this process's read-only page)
+//   VDSO (struct vdso, one read-only page shared by all)
+//   THREADFRAMEs (trapframes of threads made by clone())
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+
+// a thread's trapframe is mapped beneath TRAPFRAME,
+// at a page picked by its index in proc[].
+#define THREADFRAME(p) (TRAPFRAME - ((p)+1)*PGSIZE)
+
+// pages that the kernel keeps up to date for user code to
+// read without a system call; see vdso.h. they sit beneath
+// the THREADFRAMEs of all NPROC possible threads.
+#define VDSO (TRAPFRAME - (NPROC+1)*PGSIZE)
+#define VDSOPROC (VDSO - PGSIZE)
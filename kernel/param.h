@@ -1,13 +1,24 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
-#define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
+#define NPRIO         8  // scheduling priority levels, 0 is highest
+#define DEFPRIO       4  // base priority of init, inherited by fork
+#define PRIOALLOT 1000000  // time CSR cycles run at one level before dropping, 1 tick
+#define PRIOBOOST    10  // ticks between moving everyone back to base priority
+#define NOFILE      128  // open files per process
+#define NFILE       200  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
-#define MAXOPBLOCKS  10  // max # of blocks any FS op writes
+#define MAXOPBLOCKS  10  // max # of blocks most FS ops write
+#define COPYOPBLOCKS 20  // blocks each copy_file_range() transaction writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 #define FSSIZE       1000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define PIPEMAXPAGES 16    // largest pipe buffer, in pages
+#define NLOCKCLASS   48    // lock names that lockstat() tracks
+#define NMCS         16    // spinlocks one cpu can hold at once, with MCSLOCK
+#define SLEEPSPIN    1000  // time CSR cycles acquiresleep() spins, 100us
+#define NPROFSAMPLE  256   // profiler samples each CPU buffers
+#define NTRACE       1024  // trace events each CPU buffers
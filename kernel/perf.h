@@ -0,0 +1,3 @@
+// perfstat() who; struct perfstat is in proc.h.
+#define PERF_SELF     0  // the calling thread
+#define PERF_CHILDREN 1  // its children that wait() has reaped
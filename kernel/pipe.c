@@ -7,18 +7,45 @@
 #include "fs.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "poll.h"
 
-#define PIPESIZE 512
-
+// a pipe's buffer is a ring of whole pages, pi->size bytes long.
+// the size is always a power of two, so it divides 2^32 and the
+// free-running nread and nwrite counters stay valid when they wrap.
 struct pipe {
   struct spinlock lock;
-  char data[PIPESIZE];
+  char *buf[PIPEMAXPAGES];  // the pages of the ring
+  uint size;      // bytes in the ring, a power-of-two number of pages
   uint nread;     // number of bytes read
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
+  int rbusy;      // splice() is copying out of the ring
+  int wbusy;      // splice() is copying into the ring
+  struct pollent *pollq;  // poll() calls waiting for either end
 };
 
+// Free the first n pages of buf.
+static void
+freepages(char **buf, int n)
+{
+  for(int i = 0; i < n; i++)
+    kfree(buf[i]);
+}
+
+// Allocate n pages into buf, all or nothing.
+static int
+allocpages(char **buf, int n)
+{
+  for(int i = 0; i < n; i++){
+    if((buf[i] = kalloc()) == 0){
+      freepages(buf, i);
+      return -1;
+    }
+  }
+  return 0;
+}
+
 int
 pipealloc(struct file **f0, struct file **f1)
 {
@@ -30,10 +57,19 @@ pipealloc(struct file **f0, struct file **f1)
     goto bad;
   if((pi = (struct pipe*)kalloc()) == 0)
     goto bad;
+  if(allocpages(pi->buf, 1) < 0){
+    kfree((char*)pi);
+    pi = 0;
+    goto bad;
+  }
+  pi->size = PGSIZE;
   pi->readopen = 1;
   pi->writeopen = 1;
   pi->nwrite = 0;
   pi->nread = 0;
+  pi->rbusy = 0;
+  pi->wbusy = 0;
+  pi->pollq = 0;
   initlock(&pi->lock, "pipe");
   (*f0)->type = FD_PIPE;
   (*f0)->readable = 1;
@@ -66,17 +102,31 @@ pipeclose(struct pipe *pi, int writable)
     pi->readopen = 0;
     wakeup(&pi->nwrite);
   }
+  pollwakeup(&pi->pollq);
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
+    freepages(pi->buf, pi->size / PGSIZE);
     kfree((char*)pi);
   } else
     release(&pi->lock);
 }
 
+// Where byte off of the stream lives in pi's ring, and how many
+// bytes from there are contiguous in the same page.
+static char *
+pipeaddr(struct pipe *pi, uint off, int *contig)
+{
+  uint i = off & (pi->size - 1);
+
+  *contig = PGSIZE - (i % PGSIZE);
+  return pi->buf[i / PGSIZE] + (i % PGSIZE);
+}
+
 int
 pipewrite(struct pipe *pi, uint64 addr, int n)
 {
-  int i = 0;
+  int i = 0, m, contig;
+  char *dst;
   struct proc *pr = myproc();
 
   acquire(&pi->lock);
@@ -85,19 +135,30 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
       release(&pi->lock);
       return -1;
     }
-    if(pi->nwrite == pi->nread + PIPESIZE){ //DOC: pipewrite-full
+    if(pi->wbusy){
+      sleep(&pi->wbusy, &pi->lock);
+    } else if(pi->nwrite == pi->nread + pi->size){ //DOC: pipewrite-full
       wakeup(&pi->nread);
+      pollwakeup(&pi->pollq);
       sleep(&pi->nwrite, &pi->lock);
     } else {
-      char ch;
-      if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
+      // copy as much as fits in the ring and in the current page.
+      dst = pipeaddr(pi, pi->nwrite, &contig);
+      m = n - i;
+      if(m > pi->nread + pi->size - pi->nwrite)
+        m = pi->nread + pi->size - pi->nwrite;
+      if(m > contig)
+        m = contig;
+      if(copyin(pr->pagetable, dst, addr + i, m) == -1)
         break;
-      pi->data[pi->nwrite++ % PIPESIZE] = ch;
-      i++;
+      pi->nwrite += m;
+      i += m;
     }
   }
   wakeup(&pi->nread);
+  pollwakeup(&pi->pollq);
   release(&pi->lock);
+  pr->use.npipewrite += i;
 
   return i;
 }
@@ -105,26 +166,395 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
 int
 piperead(struct pipe *pi, uint64 addr, int n)
 {
-  int i;
+  int i, m, contig;
+  char *src;
   struct proc *pr = myproc();
-  char ch;
 
   acquire(&pi->lock);
-  while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
+  while(pi->rbusy || (pi->nread == pi->nwrite && pi->writeopen)){  //DOC: pipe-empty
     if(pr->killed){
       release(&pi->lock);
       return -1;
     }
-    sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
+    if(pi->rbusy)
+      sleep(&pi->rbusy, &pi->lock);
+    else
+      sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
+  for(i = 0; i < n; i += m){  //DOC: piperead-copy
     if(pi->nread == pi->nwrite)
       break;
-    ch = pi->data[pi->nread++ % PIPESIZE];
-    if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
+    src = pipeaddr(pi, pi->nread, &contig);
+    m = n - i;
+    if(m > pi->nwrite - pi->nread)
+      m = pi->nwrite - pi->nread;
+    if(m > contig)
+      m = contig;
+    if(copyout(pr->pagetable, addr + i, src, m) == -1)
       break;
+    pi->nread += m;
   }
   wakeup(&pi->nwrite);  //DOC: piperead-wakeup
+  pollwakeup(&pi->pollq);
   release(&pi->lock);
+  pr->use.npiperead += i;
   return i;
 }
+
+// Current size of pi's buffer, in bytes.
+int
+pipegetsize(struct pipe *pi)
+{
+  int size;
+
+  acquire(&pi->lock);
+  size = pi->size;
+  release(&pi->lock);
+  return size;
+}
+
+// Resize pi's buffer to hold at least n bytes, rounded up to a
+// power-of-two number of pages, at most PIPEMAXPAGES.
+// Fails if the buffered data would not fit, or if a splice()
+// is using the ring.
+// Returns the new size.
+int
+pipesetsize(struct pipe *pi, int n)
+{
+  char *buf[PIPEMAXPAGES], *old[PIPEMAXPAGES];
+  int npages, oldpages, m, contig;
+  uint off, count;
+
+  if(n <= 0 || n > PIPEMAXPAGES*PGSIZE)
+    return -1;
+  for(npages = 1; npages*PGSIZE < n; npages *= 2)
+    ;
+  if(npages > PIPEMAXPAGES)
+    return -1;
+  if(allocpages(buf, npages) < 0)
+    return -1;
+
+  acquire(&pi->lock);
+  count = pi->nwrite - pi->nread;
+  if(count > npages*PGSIZE || pi->rbusy || pi->wbusy){
+    release(&pi->lock);
+    freepages(buf, npages);
+    return -1;
+  }
+  // move the buffered bytes to the start of the new ring.
+  for(off = 0; off < count; off += m){
+    char *src = pipeaddr(pi, pi->nread + off, &contig);
+    m = count - off;
+    if(m > contig)
+      m = contig;
+    if(m > PGSIZE - off % PGSIZE)
+      m = PGSIZE - off % PGSIZE;
+    memmove(buf[off / PGSIZE] + off % PGSIZE, src, m);
+  }
+  oldpages = pi->size / PGSIZE;
+  memmove(old, pi->buf, oldpages * sizeof(char*));
+  memmove(pi->buf, buf, npages * sizeof(char*));
+  pi->size = npages * PGSIZE;
+  pi->nread = 0;
+  pi->nwrite = count;
+  wakeup(&pi->nwrite);
+  pollwakeup(&pi->pollq);
+  release(&pi->lock);
+
+  freepages(old, oldpages);
+  return npages * PGSIZE;
+}
+
+// splice() copies into and out of a pipe's ring without
+// holding the pipe's lock, so it claims the end it is using:
+// rbusy keeps other readers from moving nread, and wbusy keeps
+// other writers from moving nwrite, until it is done.
+
+// Wait for data in pi past the first skip bytes, unless
+// !block, and claim the read end. Sets *addr to the data and
+// returns how many bytes of it there are, up to n, within one
+// page. Returns 0 at end of file or if there is nothing to
+// read without blocking, -1 if killed.
+static int
+rbegin(struct pipe *pi, uint skip, char **addr, int n, int block)
+{
+  struct proc *pr = myproc();
+  int contig;
+  uint m;
+
+  acquire(&pi->lock);
+  for(;;){
+    if(pr->killed){
+      release(&pi->lock);
+      return -1;
+    }
+    if(pi->rbusy)
+      sleep(&pi->rbusy, &pi->lock);
+    else if(block && pi->nwrite - pi->nread <= skip && pi->writeopen)
+      sleep(&pi->nread, &pi->lock);
+    else
+      break;
+  }
+  m = pi->nwrite - pi->nread;
+  if(m <= skip){
+    release(&pi->lock);
+    return 0;
+  }
+  m -= skip;
+  *addr = pipeaddr(pi, pi->nread + skip, &contig);
+  if(m > n)
+    m = n;
+  if(m > contig)
+    m = contig;
+  pi->rbusy = 1;
+  release(&pi->lock);
+  return m;
+}
+
+// Release the read end claimed by rbegin(), consuming n bytes.
+static void
+rend(struct pipe *pi, int n)
+{
+  acquire(&pi->lock);
+  pi->nread += n;
+  pi->rbusy = 0;
+  wakeup(&pi->rbusy);
+  if(n > 0){
+    wakeup(&pi->nwrite);
+    pollwakeup(&pi->pollq);
+  }
+  release(&pi->lock);
+}
+
+// Wait for space in pi, unless !block, and claim the write
+// end. Sets *addr to the free space and returns how many bytes
+// of it there are, up to n, within one page. Returns 0 if pi
+// is full and !block, -1 if the read end is closed or if killed.
+static int
+wbegin(struct pipe *pi, char **addr, int n, int block)
+{
+  struct proc *pr = myproc();
+  int contig;
+  uint m;
+
+  acquire(&pi->lock);
+  for(;;){
+    if(pi->readopen == 0 || pr->killed){
+      release(&pi->lock);
+      return -1;
+    }
+    if(pi->wbusy)
+      sleep(&pi->wbusy, &pi->lock);
+    else if(pi->nwrite == pi->nread + pi->size && block)
+      sleep(&pi->nwrite, &pi->lock);
+    else
+      break;
+  }
+  m = pi->nread + pi->size - pi->nwrite;
+  if(m == 0){
+    release(&pi->lock);
+    return 0;
+  }
+  *addr = pipeaddr(pi, pi->nwrite, &contig);
+  if(m > n)
+    m = n;
+  if(m > contig)
+    m = contig;
+  pi->wbusy = 1;
+  release(&pi->lock);
+  return m;
+}
+
+// Release the write end claimed by wbegin(), adding n bytes.
+static void
+wend(struct pipe *pi, int n)
+{
+  acquire(&pi->lock);
+  pi->nwrite += n;
+  pi->wbusy = 0;
+  wakeup(&pi->wbusy);
+  if(n > 0){
+    wakeup(&pi->nread);
+    pollwakeup(&pi->pollq);
+  }
+  release(&pi->lock);
+}
+
+// The ring slot that holds byte off of pi's stream;
+// the caller has claimed that end of the pipe.
+static char **
+pipeslot(struct pipe *pi, uint off)
+{
+  return &pi->buf[(off & (pi->size - 1)) / PGSIZE];
+}
+
+// Move up to n bytes from pipe in to pipe out, waiting for
+// data only if none has moved yet. Whole pages trade places
+// between the two rings instead of being copied. If tee, copy
+// the bytes and leave them in pipe in as well.
+// Returns the number of bytes moved, or -1.
+int
+pipesplice(struct pipe *in, struct pipe *out, int n, int tee)
+{
+  int done = 0, m, w;
+  char *src, *dst, **sslot, **dslot;
+
+  if(in == out)
+    return -1;
+  while(done < n){
+    if((m = rbegin(in, tee ? done : 0, &src, n - done, done == 0)) <= 0){
+      if(m < 0 && done == 0)
+        done = -1;
+      break;
+    }
+    if((w = wbegin(out, &dst, m, 0)) <= 0){
+      // don't wait for room in out with in's read end claimed:
+      // what would make the room may be a reader of in, or a
+      // splice the other way, waiting for that claim.
+      rend(in, 0);
+      if(w == 0 && done == 0 && (w = wbegin(out, &dst, 1, 1)) > 0){
+        wend(out, 0);
+        continue;
+      }
+      if(w < 0 && done == 0)
+        done = -1;
+      break;
+    }
+    if(!tee && w == PGSIZE){
+      // a whole page in each ring: exchange them. only this
+      // call may touch either slot until rend() and wend().
+      sslot = pipeslot(in, in->nread);
+      dslot = pipeslot(out, out->nwrite);
+      acquire(&in->lock);
+      *sslot = dst;
+      release(&in->lock);
+      acquire(&out->lock);
+      *dslot = src;
+      release(&out->lock);
+    } else {
+      memmove(dst, src, w);
+    }
+    wend(out, w);
+    rend(in, tee ? 0 : w);
+    done += w;
+  }
+  if(done > 0){
+    myproc()->use.npiperead += done;
+    myproc()->use.npipewrite += done;
+  }
+  return done;
+}
+
+// Move up to n bytes from file or device f into pi, reading
+// straight into the ring. Stops at end of file.
+// Returns the number of bytes moved, or -1.
+int
+pipefill(struct pipe *pi, struct file *f, int n)
+{
+  int done = 0, m, r;
+  char *dst;
+
+  while(done < n){
+    if((m = wbegin(pi, &dst, n - done, 1)) < 0){
+      if(done == 0)
+        done = -1;
+      break;
+    }
+    if(f->type == FD_DEVICE){
+      r = devsw[f->major].read(0, (uint64)dst, m);
+    } else {
+      ilock(f->ip);
+      if((r = readi(f->ip, 0, (uint64)dst, f->off, m)) > 0)
+        f->off += r;
+      iunlock(f->ip);
+    }
+    wend(pi, r > 0 ? r : 0);
+    if(r < 0){
+      if(done == 0)
+        done = -1;
+      break;
+    }
+    done += r;
+    // a device returns what it has; don't wait for more.
+    if(r == 0 || r < m || f->type == FD_DEVICE)
+      break;
+  }
+  if(done > 0)
+    myproc()->use.npipewrite += done;
+  return done;
+}
+
+// Move up to n bytes from pi to file or device f, writing
+// straight out of the ring, waiting for data only if none
+// has moved yet. Returns the number of bytes moved, or -1.
+int
+pipedrain(struct pipe *pi, struct file *f, int n)
+{
+  // as in filewrite(), keep each log transaction small.
+  int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+  int done = 0, m, r;
+  char *src;
+
+  while(done < n){
+    if((m = rbegin(pi, 0, &src, n - done < max ? n - done : max, done == 0)) <= 0){
+      if(m < 0 && done == 0)
+        done = -1;
+      break;
+    }
+    if(f->type == FD_DEVICE){
+      r = devsw[f->major].write(0, (uint64)src, m);
+    } else {
+      begin_op();
+      ilock(f->ip);
+      if((r = writei(f->ip, 0, (uint64)src, f->off, m)) > 0)
+        f->off += r;
+      iunlock(f->ip);
+      end_op();
+    }
+    rend(pi, r > 0 ? r : 0);
+    if(r < 0){
+      if(done == 0)
+        done = -1;
+      break;
+    }
+    done += r;
+    if(r != m)
+      break;
+  }
+  if(done > 0)
+    myproc()->use.npiperead += done;
+  return done;
+}
+
+// Which of events are ready on the read end of pi, or the
+// write end if writable; for filepoll().
+int
+pipepoll(struct pipe *pi, int writable, int events, struct pollent *pe)
+{
+  int r = 0;
+
+  acquire(&pi->lock);
+  if(writable){
+    if(pi->nwrite < pi->nread + pi->size)
+      r |= POLLOUT;
+    if(pi->readopen == 0)
+      r |= POLLERR;
+  } else {
+    if(pi->nread != pi->nwrite)
+      r |= POLLIN;
+    if(pi->writeopen == 0)
+      r |= POLLHUP;
+  }
+  if(pe)
+    pollwait(&pi->pollq, pe);
+  release(&pi->lock);
+  return r & (events | POLLERR | POLLHUP);
+}
+
+void
+pipeunpoll(struct pipe *pi, struct pollent *pe)
+{
+  acquire(&pi->lock);
+  pollcancel(&pi->pollq, pe);
+  release(&pi->lock);
+}
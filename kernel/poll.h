@@ -0,0 +1,14 @@
+// for poll(), which waits until one of several
+// file descriptors is ready (see kernel/file.c).
+
+struct pollfd {
+  int fd;          // ignored if negative
+  short events;    // what to wait for
+  short revents;   // what is ready, set by poll()
+};
+
+#define POLLIN   0x001  // read() will not block
+#define POLLOUT  0x004  // write() will not block
+#define POLLERR  0x008  // pipe with no reader left
+#define POLLHUP  0x010  // pipe with no writer left
+#define POLLNVAL 0x020  // fd is not open
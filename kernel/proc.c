@@ -4,17 +4,93 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sleeplock.h"
 #include "defs.h"
+#include "vdso.h"
+#include "trace.h"
+#include "perf.h"
+#include "procstat.h"
 
 struct cpu cpus[NCPU];
 
 struct proc proc[NPROC];
 
+// the page at VDSO in every process.
+struct vdso *vdso;
+
 struct proc *initproc;
 
+// Per-CPU queues of RUNNABLE processes, one FIFO per
+// priority level (see p->prio).
+// A process is on exactly one queue while it is RUNNABLE,
+// and is put there with its p->lock held, so the
+// lock order is p->lock, then the queue's lock.
+// Each queue sits on its own cache line(s).
+struct runq {
+  struct spinlock lock;
+  int n;                      // number of queued processes
+  struct proc *head[NPRIO];
+  struct proc *tail[NPRIO];
+} __attribute__ ((aligned (64))) runq[NCPU];
+
+// Sleeping processes, hashed by the channel they sleep on,
+// so that wakeup() only looks at processes that may be waiting.
+// Lock order: the sleep queue's lock, then p->lock.
+#define NSLEEPQ 64
+
+struct sleepq {
+  struct spinlock lock;
+  struct proc *head;          // FIFO, linked through p->sqnext
+  struct proc *tail;
+} __attribute__ ((aligned (64))) sleepq[NSLEEPQ];
+
+// serialize futexwait()'s check of a user int against
+// futexwake() on the same int.
+#define NFUTEXLOCK 16
+struct spinlock futexlock[NFUTEXLOCK];
+
+// Unlink p from sq, where prev is the process before it, or 0.
+// sq->lock must be held.
+static void
+sleepqremove(struct sleepq *sq, struct proc *prev, struct proc *p)
+{
+  if(prev)
+    prev->sqnext = p->sqnext;
+  else
+    sq->head = p->sqnext;
+  if(sq->tail == p)
+    sq->tail = prev;
+  p->sqnext = 0;
+}
+
+static struct sleepq*
+sleepqof(void *chan)
+{
+  // channels are mostly addresses inside page-aligned objects,
+  // so mix the page number bits into the bucket index.
+  return &sleepq[((uint64)chan * 0x9e3779b97f4a7c15UL) >> 58];
+}
+
 int nextpid = 1;
 struct spinlock pid_lock;
 
+// Processes by pid, for findproc(). Readers walk the buckets
+// without a lock, under rcubegin(); pid_lock serializes changes.
+#define NPIDHASH 16
+struct proc *pidhash[NPIDHASH];
+
+// Read-copy-update. Lookups in tables that rarely change, such
+// as pidhash and the inode cache, take no lock: they keep
+// interrupts off between rcubegin() and rcuend(), so the CPU
+// cannot pass through the scheduler meanwhile. An entry that is
+// unlinked from such a table is stamped with rcuretire(), and
+// is not reused until rcudone() says that every CPU has been
+// through the scheduler (a quiescent state) since then, so no
+// lookup can still be looking at it.
+uint64 rcuclock = 1;
+
+#define RCU_IDLE (~0UL)  // c->rcuepoch of a CPU in no read section at all
+
 extern void forkret(void);
 static void freeproc(struct proc *p);
 
@@ -26,6 +102,57 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
+// address space IDs in use by thread groups; the
+// kernel's page table has ASID 0.
+struct spinlock asid_lock;
+char asidused[NPROC+1];
+
+// An ASID for a new thread group: there are enough for
+// every thread group, if there are any at all.
+static int
+allocasid(void)
+{
+  int a = 0;
+
+  if(!asids)
+    return 0;
+  acquire(&asid_lock);
+  for(a = 1; a <= NPROC; a++)
+    if(!asidused[a])
+      break;
+  if(a > NPROC)
+    panic("allocasid");
+  asidused[a] = 1;
+  release(&asid_lock);
+  return a;
+}
+
+// The next user of a freed ASID builds its page table
+// with mappages(), which makes every CPU flush its TLB
+// before it can run with that ASID again.
+static void
+freeasid(int a)
+{
+  acquire(&asid_lock);
+  asidused[a] = 0;
+  release(&asid_lock);
+}
+
+// Must this CPU flush its TLB before returning to user space?
+// Yes if it has no ASIDs, or if some mapping has changed since
+// it last flushed. Interrupts must be off.
+int
+tlbstale(void)
+{
+  struct cpu *c = mycpu();
+  uint64 g = __atomic_load_n(&tlbgen, __ATOMIC_ACQUIRE);
+
+  if(asids && c->tlbgen == g)
+    return 0;
+  c->tlbgen = g;
+  return 1;
+}
+
 // Allocate a page for each process's kernel stack.
 // Map it high in memory, followed by an invalid
 // guard page.
@@ -50,6 +177,21 @@ procinit(void)
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
+  initlock(&asid_lock, "asid");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&runq[i].lock, "runq");
+  for(int i = 0; i < NSLEEPQ; i++)
+    initlock(&sleepq[i].lock, "sleepq");
+  for(int i = 0; i < NFUTEXLOCK; i++)
+    initlock(&futexlock[i], "futex");
+  // CPUs count as idle until they reach the scheduler.
+  for(int i = 0; i < NCPU; i++)
+    cpus[i].rcuepoch = RCU_IDLE;
+
+  if((vdso = (struct vdso *)kalloc()) == 0)
+    panic("procinit: vdso");
+  memset(vdso, 0, PGSIZE);
+  vdso->hz = MTIME_HZ;
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
       p->kstack = KSTACK((int) (p - proc));
@@ -85,40 +227,327 @@ myproc(void) {
   return p;
 }
 
+void
+rcubegin(void)
+{
+  push_off();
+}
+
+void
+rcuend(void)
+{
+  pop_off();
+}
+
+// The epoch in which an entry is unlinked from an RCU-read table.
+uint64
+rcuretire(void)
+{
+  return __sync_fetch_and_add(&rcuclock, 1);
+}
+
+// Has every CPU passed a quiescent state since epoch?
 int
-allocpid() {
-  int pid;
-  
+rcudone(uint64 epoch)
+{
+  for(struct cpu *c = cpus; c < &cpus[NCPU]; c++)
+    if(__atomic_load_n(&c->rcuepoch, __ATOMIC_ACQUIRE) <= epoch)
+      return 0;
+  return 1;
+}
+
+// Wait until rcudone(epoch), letting the scheduler run so that
+// this CPU passes its own quiescent state.
+void
+rcuwait(uint64 epoch)
+{
+  while(!rcudone(epoch))
+    yield();
+}
+
+// c is in the scheduler, in no read section.
+static void
+rcuquiesce(struct cpu *c)
+{
+  __atomic_store_n(&c->rcuepoch, __atomic_load_n(&rcuclock, __ATOMIC_ACQUIRE),
+                   __ATOMIC_RELEASE);
+}
+
+static struct proc**
+pidbucket(int pid)
+{
+  return &pidhash[pid % NPIDHASH];
+}
+
+// Give p a new pid, and add p to pidhash.
+static void
+allocpid(struct proc *p)
+{
+  struct proc **b;
+
   acquire(&pid_lock);
-  pid = nextpid;
+  p->pid = nextpid;
   nextpid = nextpid + 1;
+  b = pidbucket(p->pid);
+  p->pidnext = *b;
+  // publish p only once p->pid and p->pidnext are set.
+  __atomic_store_n(b, p, __ATOMIC_RELEASE);
   release(&pid_lock);
+}
 
-  return pid;
+// Take p out of pidhash. p->pidnext stays as it is, for
+// findproc() calls that are looking at p right now.
+static void
+piddel(struct proc *p)
+{
+  struct proc **pp;
+
+  acquire(&pid_lock);
+  for(pp = pidbucket(p->pid); *pp; pp = &(*pp)->pidnext){
+    if(*pp == p){
+      __atomic_store_n(pp, p->pidnext, __ATOMIC_RELEASE);
+      break;
+    }
+  }
+  release(&pid_lock);
+}
+
+// Find the process with the given pid, taking no lock but its
+// own: returns it with p->lock held, or 0.
+static struct proc*
+findproc(int pid)
+{
+  struct proc *p;
+
+  if(pid <= 0)
+    return 0;
+  rcubegin();
+  for(p = __atomic_load_n(pidbucket(pid), __ATOMIC_ACQUIRE); p;
+      p = __atomic_load_n(&p->pidnext, __ATOMIC_ACQUIRE)){
+    if(p->pid == pid){
+      // p can't be reused before rcuend(), but it may be
+      // exiting: check again with its lock held.
+      acquire(&p->lock);
+      rcuend();
+      if(p->pid == pid && p->state != UNUSED)
+        return p;
+      release(&p->lock);
+      return 0;
+    }
+  }
+  rcuend();
+  return 0;
+}
+
+// Append p to the run queue of the CPU it last ran on,
+// at its current priority.
+// p->lock must be held.
+static void
+runqput(struct proc *p)
+{
+  struct runq *rq = &runq[p->cpu];
+
+  acquire(&rq->lock);
+  p->rqnext = 0;
+  if(rq->tail[p->prio])
+    rq->tail[p->prio]->rqnext = p;
+  else
+    rq->head[p->prio] = p;
+  rq->tail[p->prio] = p;
+  rq->n++;
+  release(&rq->lock);
+
+  // release() is a fence, so an idle() that has not seen
+  // rq->n yet has already set its idle flag for us to see.
+  // wake p's CPU if it is idle, or else another idle CPU
+  // that can steal p.
+  if(__atomic_load_n(&cpus[p->cpu].idle, __ATOMIC_RELAXED)){
+    ipi(p->cpu);
+  } else {
+    for(int i = 0; i < NCPU; i++){
+      if(__atomic_load_n(&cpus[i].idle, __ATOMIC_RELAXED)){
+        ipi(i);
+        break;
+      }
+    }
+  }
+}
+
+// Remove p from its run queue, if a scheduler has not already
+// taken it off. Returns 1 if p was found on the queue.
+// p->lock must be held.
+static int
+runqremove(struct proc *p)
+{
+  struct runq *rq = &runq[p->cpu];
+  struct proc **pp, *prev = 0;
+  int found = 0;
+
+  acquire(&rq->lock);
+  for(pp = &rq->head[p->prio]; *pp; prev = *pp, pp = &(*pp)->rqnext){
+    if(*pp == p){
+      *pp = p->rqnext;
+      if(rq->tail[p->prio] == p)
+        rq->tail[p->prio] = prev;
+      p->rqnext = 0;
+      rq->n--;
+      found = 1;
+      break;
+    }
+  }
+  release(&rq->lock);
+  return found;
+}
+
+// Take the highest-priority process from CPU id's run queue.
+// Returns 0 if the queue is empty.
+static struct proc*
+runqget(int id)
+{
+  struct runq *rq = &runq[id];
+  struct proc *p = 0;
+
+  // peek without the lock, so that idle CPUs looking for
+  // work do not bounce the lock of every empty queue.
+  // rq->n changes under us: load it once, as an atomic.
+  if(__atomic_load_n(&rq->n, __ATOMIC_RELAXED) == 0)
+    return 0;
+
+  acquire(&rq->lock);
+  for(int i = 0; i < NPRIO; i++){
+    if((p = rq->head[i]) != 0){
+      rq->head[i] = p->rqnext;
+      if(rq->head[i] == 0)
+        rq->tail[i] = 0;
+      p->rqnext = 0;
+      rq->n--;
+      break;
+    }
+  }
+  release(&rq->lock);
+  return p;
+}
+
+// Mark p RUNNABLE and put it on a run queue.
+// p->lock must be held.
+static void
+setrunnable(struct proc *p)
+{
+  p->state = RUNNABLE;
+  runqput(p);
+}
+
+// Change p's effective priority, moving it to the
+// matching run queue list if it is waiting on one.
+// p->lock must be held.
+static void
+setprio(struct proc *p, int prio)
+{
+  if(p->prio == prio)
+    return;
+  if(p->state == RUNNABLE && runqremove(p)){
+    p->prio = prio;
+    runqput(p);
+  } else {
+    p->prio = prio;
+  }
+}
+
+// Recompute p's effective priority: its MLFQ level, or
+// better if waiters on sleep locks it holds lent it theirs.
+// p->lock must be held.
+static void
+reprio(struct proc *p)
+{
+  setprio(p, p->lent < p->level ? p->lent : p->level);
+}
+
+// Charge p for ran cycles at its level, and drop it a level
+// once it has used up PRIOALLOT there, whether in one stretch
+// or in many short ones between sleeps.
+// p->lock must be held.
+static void
+chargeprio(struct proc *p, uint64 ran)
+{
+  p->ran += ran;
+  if(p->ran >= PRIOALLOT){
+    p->ran = 0;
+    if(p->level < NPRIO-1){
+      p->level++;
+      reprio(p);
+    }
+  }
+}
+
+// Set by clockintr() every PRIOBOOST ticks; the next scheduler
+// to look does the boost, outside the timer interrupt.
+int boostpending;
+
+// Move every process back up to its base priority, so that ones
+// that have sunk to the bottom levels still get to run, and ones
+// whose behavior changed are judged afresh. Peeks first without
+// the lock, so that only processes that need it are locked.
+static void
+prioboost(void)
+{
+  struct proc *p;
+
+  for(p = proc; p < &proc[NPROC]; p++){
+    if(__atomic_load_n(&p->state, __ATOMIC_RELAXED) == UNUSED ||
+       (__atomic_load_n(&p->level, __ATOMIC_RELAXED) == p->nice &&
+        __atomic_load_n(&p->ran, __ATOMIC_RELAXED) == 0))
+      continue;
+    acquire(&p->lock);
+    if(p->state != UNUSED){
+      p->level = p->nice;
+      p->ran = 0;
+      reprio(p);
+    }
+    release(&p->lock);
+  }
 }
 
 // Look in the process table for an UNUSED proc.
 // If found, initialize state required to run in the kernel,
 // and return with p->lock held.
+// If tg is 0, the proc starts a new thread group with an empty
+// user page table; otherwise it joins tg as another thread.
 // If there are no free procs, or a memory allocation fails, return 0.
 static struct proc*
-allocproc(void)
+allocproc(struct tgroup *tg)
 {
   struct proc *p;
+  int retired;
 
+again:
+  retired = 0;
   for(p = proc; p < &proc[NPROC]; p++) {
     acquire(&p->lock);
     if(p->state == UNUSED) {
-      goto found;
-    } else {
-      release(&p->lock);
+      // a findproc() may still be walking through a recently
+      // freed proc; don't reuse it until none can be.
+      if(!p->retired || rcudone(p->epoch))
+        goto found;
+      retired = 1;
     }
+    release(&p->lock);
+  }
+  if(retired && myproc()){
+    yield();
+    goto again;
   }
   return 0;
 
 found:
-  p->pid = allocpid();
+  p->retired = 0;
+  allocpid(p);
   p->state = USED;
+  memset(&p->perf, 0, sizeof(p->perf));
+  memset(&p->cperf, 0, sizeof(p->cperf));
+  memset(&p->use, 0, sizeof(p->use));
+  p->lent = NPRIO;
+  p->held = 0;
+  p->ran = 0;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -127,13 +556,55 @@ found:
     return 0;
   }
 
-  // An empty user page table.
-  p->pagetable = proc_pagetable(p);
-  if(p->pagetable == 0){
-    freeproc(p);
-    release(&p->lock);
-    return 0;
+  if(tg == 0){
+    // A new thread group, with an empty user page table.
+    if((tg = (struct tgroup *)kalloc()) == 0){
+      freeproc(p);
+      release(&p->lock);
+      return 0;
+    }
+    memset(tg, 0, sizeof(*tg));
+    initlock(&tg->lock, "tgroup");
+    if((tg->vdso = (struct vdsoproc *)kalloc()) == 0){
+      kfree((void*)tg);
+      freeproc(p);
+      release(&p->lock);
+      return 0;
+    }
+    memset(tg->vdso, 0, PGSIZE);
+    tg->vdso->pid = p->pid;
+    tg->asid = allocasid();
+    p->tg = tg;
+    p->tfva = TRAPFRAME;
+    if((tg->pagetable = proc_pagetable(p)) == 0){
+      p->tg = 0;
+      if(tg->asid)
+        freeasid(tg->asid);
+      kfree((void*)tg->vdso);
+      kfree((void*)tg);
+      freeproc(p);
+      release(&p->lock);
+      return 0;
+    }
+    tg->ref = 1;
+    tg->nthread = 1;
+  } else {
+    // A new thread: map its trapframe into the group's page table.
+    p->tfva = THREADFRAME((int) (p - proc));
+    acquire(&tg->lock);
+    if(mappages(tg->pagetable, p->tfva, PGSIZE,
+                (uint64)(p->trapframe), PTE_R | PTE_W) < 0){
+      release(&tg->lock);
+      freeproc(p);
+      release(&p->lock);
+      return 0;
+    }
+    tg->ref++;
+    tg->nthread++;
+    release(&tg->lock);
   }
+  p->tg = tg;
+  p->pagetable = tg->pagetable;
 
   // Set up new context to start executing at forkret,
   // which returns to user space.
@@ -145,24 +616,46 @@ found:
 }
 
 // free a proc structure and the data hanging from it,
-// including user pages.
+// including user pages if it is the last of its thread group.
 // p->lock must be held.
 static void
 freeproc(struct proc *p)
 {
+  struct tgroup *tg = p->tg;
+
+  if(tg){
+    acquire(&tg->lock);
+    uvmunmap(tg->pagetable, p->tfva, 1, 0);
+    int last = (--tg->ref == 0);
+    release(&tg->lock);
+    if(last){
+      proc_freepagetable(tg->pagetable, tg->sz);
+      if(tg->asid)
+        freeasid(tg->asid);
+      kfree((void*)tg->vdso);
+      kfree((void*)tg);
+    }
+  }
+  p->tg = 0;
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
-  if(p->pagetable)
-    proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
-  p->sz = 0;
+  p->tfva = 0;
+  if(p->pid){
+    piddel(p);
+    p->epoch = rcuretire();
+    p->retired = 1;
+  }
   p->pid = 0;
   p->parent = 0;
   p->name[0] = 0;
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
+  p->nice = 0;
+  p->level = 0;
+  p->prio = 0;
   p->state = UNUSED;
 }
 
@@ -196,16 +689,34 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
+  // map the VDSO pages read-only for user code.
+  if(mappages(pagetable, VDSO, PGSIZE, (uint64)vdso, PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+  if(mappages(pagetable, VDSOPROC, PGSIZE,
+              (uint64)(p->tg->vdso), PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, VDSO, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
   return pagetable;
 }
 
 // Free a process's page table, and free the
 // physical memory it refers to.
+// Trapframe pages must already have been unmapped.
 void
 proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
-  uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, VDSO, 1, 0);
+  uvmunmap(pagetable, VDSOPROC, 1, 0);
   uvmfree(pagetable, sz);
 }
 
@@ -227,44 +738,60 @@ userinit(void)
 {
   struct proc *p;
 
-  p = allocproc();
+  p = allocproc(0);
   initproc = p;
   
   // allocate one user page and copy init's instructions
   // and data into it.
   uvminit(p->pagetable, initcode, sizeof(initcode));
-  p->sz = PGSIZE;
+  p->tg->sz = PGSIZE;
 
   // prepare for the very first "return" from kernel to user.
   p->trapframe->epc = 0;      // user program counter
   p->trapframe->sp = PGSIZE;  // user stack pointer
 
   safestrcpy(p->name, "initcode", sizeof(p->name));
-  p->cwd = namei("/");
+  p->tg->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  p->nice = p->level = p->prio = DEFPRIO;
+  p->cpu = cpuid();
+  setrunnable(p);
 
   release(&p->lock);
 }
 
 // Grow or shrink user memory by n bytes.
-// Return 0 on success, -1 on failure.
+// Return the old size on success, -1 on failure.
+//
+// Other threads of the process may be using the page table on
+// other CPUs, from user space through their TLBs and in the
+// kernel through walk() without tg->lock. So while there are
+// any, only add mappings, never take one away: refuse to
+// shrink. uvmalloc() grows all or nothing, so a failed grow
+// leaves nothing to take away either.
 int
 growproc(int n)
 {
-  uint sz;
-  struct proc *p = myproc();
+  uint sz, oldsz;
+  struct tgroup *tg = myproc()->tg;
 
-  sz = p->sz;
+  acquire(&tg->lock);
+  sz = oldsz = tg->sz;
   if(n > 0){
-    if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
+    if((sz = uvmalloc(tg->pagetable, sz, sz + n)) == 0) {
+      release(&tg->lock);
       return -1;
     }
   } else if(n < 0){
-    sz = uvmdealloc(p->pagetable, sz, sz + n);
+    if(tg->nthread > 1){
+      release(&tg->lock);
+      return -1;
+    }
+    sz = uvmdealloc(tg->pagetable, sz, sz + n);
   }
-  p->sz = sz;
-  return 0;
+  tg->sz = sz;
+  release(&tg->lock);
+  return oldsz;
 }
 
 // Create a new process, copying the parent.
@@ -277,17 +804,26 @@ fork(void)
   struct proc *p = myproc();
 
   // Allocate process.
-  if((np = allocproc()) == 0){
+  if((np = allocproc(0)) == 0){
     return -1;
   }
 
   // Copy user memory from parent to child.
-  if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+  acquire(&p->tg->lock);
+  if(uvmcopy(p->pagetable, np->pagetable, p->tg->sz) < 0){
+    release(&p->tg->lock);
     freeproc(np);
     release(&np->lock);
     return -1;
   }
-  np->sz = p->sz;
+  np->tg->sz = p->tg->sz;
+
+  // increment reference counts on open file descriptors.
+  for(i = 0; i < NOFILE; i++)
+    if(p->tg->ofile[i])
+      np->tg->ofile[i] = filedup(p->tg->ofile[i]);
+  np->tg->cwd = idup(p->tg->cwd);
+  release(&p->tg->lock);
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -295,13 +831,164 @@ fork(void)
   // Cause fork to return 0 in the child.
   np->trapframe->a0 = 0;
 
-  // increment reference counts on open file descriptors.
-  for(i = 0; i < NOFILE; i++)
-    if(p->ofile[i])
-      np->ofile[i] = filedup(p->ofile[i]);
-  np->cwd = idup(p->cwd);
+  safestrcpy(np->name, p->name, sizeof(p->name));
+
+  // the child starts at the top of the parent's priority range.
+  np->nice = np->level = np->prio = p->nice;
+
+  pid = np->pid;
+
+  release(&np->lock);
+
+  acquire(&wait_lock);
+  np->parent = p;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  np->cpu = cpuid();
+  setrunnable(np);
+  release(&np->lock);
+
+  return pid;
+}
+
+// Create a new process running the program at path with argv,
+// without the copy of the caller's memory that fork() would
+// make only for exec() to throw away.
+// The child's file descriptor i refers to the caller's fds[i],
+// or is closed if fds[i] is -1; the child has no other open files.
+// Return the child's pid, or -1.
+int
+spawn(char *path, char **argv, int *fds, int nfds)
+{
+  int i, pid, argc;
+  struct proc *np;
+  struct proc *p = myproc();
+
+  if(nfds < 0 || nfds > NOFILE)
+    return -1;
+
+  if((np = allocproc(0)) == 0){
+    return -1;
+  }
+  memset(np->trapframe, 0, sizeof(*np->trapframe));
+  np->nice = np->level = np->prio = p->nice;
+  // no one else knows about np yet, and loading the
+  // program may sleep.
+  release(&np->lock);
+
+  // take the files before loading the program, so that a bad
+  // fd fails fast, and so that another thread closing one of
+  // them while execinto() sleeps cannot change what the child
+  // gets.
+  acquire(&p->tg->lock);
+  for(i = 0; i < nfds; i++){
+    if(fds[i] != -1 && (fds[i] < 0 || fds[i] >= NOFILE || p->tg->ofile[fds[i]] == 0)){
+      release(&p->tg->lock);
+      goto bad;
+    }
+  }
+  for(i = 0; i < nfds; i++)
+    if(fds[i] != -1)
+      np->tg->ofile[i] = filedup(p->tg->ofile[fds[i]]);
+  release(&p->tg->lock);
+
+  if((argc = execinto(np, path, argv)) < 0)
+    goto bad;
+  np->trapframe->a0 = argc;
+
+  acquire(&p->tg->lock);
+  np->tg->cwd = idup(p->tg->cwd);
+  release(&p->tg->lock);
+
+  pid = np->pid;
+
+  acquire(&wait_lock);
+  np->parent = p;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  np->cpu = cpuid();
+  setrunnable(np);
+  release(&np->lock);
+
+  return pid;
+
+ bad:
+  for(i = 0; i < nfds; i++){
+    if(np->tg->ofile[i]){
+      fileclose(np->tg->ofile[i]);
+      np->tg->ofile[i] = 0;
+    }
+  }
+  acquire(&np->lock);
+  freeproc(np);
+  release(&np->lock);
+  return -1;
+}
+
+// Create a new thread in the current process that starts
+// at fn(arg) on the user stack whose top is stack.
+// It shares the page table, open files and current
+// directory with its creator, which can wait for it with join().
+int
+clone(uint64 fn, uint64 arg, uint64 stack)
+{
+  int tid;
+  struct proc *np;
+  struct proc *p = myproc();
+
+  if(stack % 16 != 0)  // riscv sp must be 16-byte aligned
+    return -1;
+
+  if((np = allocproc(p->tg)) == 0){
+    return -1;
+  }
+
+  // start with the creator's registers (gp, tp), but
+  // at fn(arg), on the new stack.
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->sp = stack;
+  np->trapframe->a0 = arg;
+  np->trapframe->ra = 0;
 
   safestrcpy(np->name, p->name, sizeof(p->name));
+  np->nice = np->level = np->prio = p->nice;
+
+  tid = np->pid;
+
+  release(&np->lock);
+
+  acquire(&wait_lock);
+  np->parent = p;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  np->cpu = cpuid();
+  setrunnable(np);
+  release(&np->lock);
+
+  return tid;
+}
+
+// Start a thread in the caller's process that runs fn()
+// in the kernel and never returns to user space.
+// fn starts holding its p->lock, as forkret() does,
+// and ends by calling exit(). Returns its pid, or -1.
+int
+kthread(void (*fn)(void), char *name)
+{
+  int pid;
+  struct proc *np;
+  struct proc *p = myproc();
+
+  if((np = allocproc(p->tg)) == 0){
+    return -1;
+  }
+  np->context.ra = (uint64)fn;
+  safestrcpy(np->name, name, sizeof(np->name));
+  np->nice = np->level = np->prio = p->nice;
 
   pid = np->pid;
 
@@ -312,7 +999,8 @@ fork(void)
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  np->cpu = cpuid();
+  setrunnable(np);
   release(&np->lock);
 
   return pid;
@@ -333,30 +1021,48 @@ reparent(struct proc *p)
   }
 }
 
-// Exit the current process.  Does not return.
-// An exited process remains in the zombie state
-// until its parent calls wait().
+// Exit the current thread.  Does not return.
+// An exited thread remains in the zombie state
+// until its parent calls wait(), or join() for
+// a thread made by clone().
+// The last thread of a process to exit closes its files.
 void
 exit(int status)
 {
   struct proc *p = myproc();
+  struct tgroup *tg = p->tg;
+  int last, poller = 0;
 
   if(p == initproc)
     panic("init exiting");
 
-  // Close all open files.
-  for(int fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd]){
-      struct file *f = p->ofile[fd];
-      fileclose(f);
-      p->ofile[fd] = 0;
+  acquire(&tg->lock);
+  last = (--tg->nthread == 0);
+  // a ring poller ends with the last thread it serves.
+  if(tg->poller && tg->nthread == 1)
+    poller = tg->poller;
+  release(&tg->lock);
+
+  // kill() rather than wakeup(), in case the poller is
+  // blocked in a read or write it was asked to do.
+  if(poller)
+    kill(poller);
+
+  if(last){
+    // Close all open files.
+    for(int fd = 0; fd < NOFILE; fd++){
+      if(tg->ofile[fd]){
+        struct file *f = tg->ofile[fd];
+        fileclose(f);
+        tg->ofile[fd] = 0;
+      }
     }
-  }
 
-  begin_op();
-  iput(p->cwd);
-  end_op();
-  p->cwd = 0;
+    begin_op();
+    iput(tg->cwd);
+    end_op();
+    tg->cwd = 0;
+  }
 
   acquire(&wait_lock);
 
@@ -365,6 +1071,14 @@ exit(int status)
 
   // Parent might be sleeping in wait().
   wakeup(p->parent);
+
+  // and if this is the group's last thread, so might the
+  // parents of the group's zombies, in other groups.
+  if(last){
+    for(struct proc *q = proc; q < &proc[NPROC]; q++)
+      if(q != p && q->tg == tg && q->parent && q->parent->tg != tg)
+        wakeup(q->parent);
+  }
   
   acquire(&p->lock);
 
@@ -378,8 +1092,56 @@ exit(int status)
   panic("zombie exit");
 }
 
+static void
+perfadd(struct perfstat *to, struct perfstat *from)
+{
+  to->cycles += from->cycles;
+  to->instret += from->instret;
+  to->utime += from->utime;
+  to->stime += from->stime;
+}
+
+// Charge p, running on c, for the counters since c->mark, and
+// start counting again from now. All of the time goes to stime:
+// usertrap() moves the part spent in user space to utime.
+// Interrupts are off.
+static void
+perfcharge(struct proc *p, struct cpu *c)
+{
+  uint64 cycles = r_cycle(), instret = r_instret(), now = r_time();
+
+  p->perf.cycles += cycles - c->mark.cycles;
+  p->perf.instret += instret - c->mark.instret;
+  p->perf.stime += now - c->mark.stime;
+  c->mark.cycles = cycles;
+  c->mark.instret = instret;
+  c->mark.stime = now;
+}
+
+// Copy the calling thread's counters, or those of the children
+// it has waited for, to user address addr.
+int
+perfstat(uint64 addr, int who)
+{
+  struct proc *p = myproc();
+  struct perfstat ps;
+
+  if(who == PERF_SELF){
+    push_off();
+    perfcharge(p, mycpu());
+    ps = p->perf;
+    pop_off();
+  } else if(who == PERF_CHILDREN){
+    ps = p->cperf;
+  } else {
+    return -1;
+  }
+  return copyout(p->pagetable, addr, (char*)&ps, sizeof(ps));
+}
+
 // Wait for a child process to exit and return its pid.
 // Return -1 if this process has no children.
+// Threads of this process are left to join().
 int
 wait(uint64 addr)
 {
@@ -393,12 +1155,15 @@ wait(uint64 addr)
     // Scan through table looking for exited children.
     havekids = 0;
     for(np = proc; np < &proc[NPROC]; np++){
-      if(np->parent == p){
+      if(np->parent == p && np->tg != p->tg){
         // make sure the child isn't still in exit() or swtch().
         acquire(&np->lock);
 
         havekids = 1;
-        if(np->state == ZOMBIE){
+        // the child's other threads may still be running;
+        // exit() wakes us again once the last of them exits,
+        // after it has counted itself out and taken wait_lock.
+        if(np->state == ZOMBIE && __atomic_load_n(&np->tg->nthread, __ATOMIC_RELAXED) == 0){
           // Found one.
           pid = np->pid;
           if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
@@ -407,6 +1172,8 @@ wait(uint64 addr)
             release(&wait_lock);
             return -1;
           }
+          perfadd(&p->cperf, &np->perf);
+          perfadd(&p->cperf, &np->cperf);
           freeproc(np);
           release(&np->lock);
           release(&wait_lock);
@@ -427,10 +1194,119 @@ wait(uint64 addr)
   }
 }
 
+// Wait for thread tid, made by this thread with clone(),
+// to exit, and free it.
+// Return tid, or -1 if there is no such thread.
+int
+join(int tid)
+{
+  struct proc *np;
+  int found;
+  struct proc *p = myproc();
+
+  acquire(&wait_lock);
+
+  for(;;){
+    found = 0;
+    for(np = proc; np < &proc[NPROC]; np++){
+      if(np->parent == p && np->tg == p->tg){
+        acquire(&np->lock);
+        if(np->pid == tid){
+          found = 1;
+          if(np->state == ZOMBIE){
+            perfadd(&p->perf, &np->perf);
+            freeproc(np);
+            release(&np->lock);
+            release(&wait_lock);
+            return tid;
+          }
+        }
+        release(&np->lock);
+        if(found)
+          break;
+      }
+    }
+
+    if(!found || p->killed){
+      release(&wait_lock);
+      return -1;
+    }
+
+    // Wait for a child to exit.
+    sleep(p, &wait_lock);
+  }
+}
+
+// Kill thread tid of the caller's thread group, wait for it
+// to exit, and free it, whichever thread made it.
+// Return 0, or -1 if there is no such thread.
+int
+reapthread(int tid)
+{
+  struct proc *np;
+  struct proc *p = myproc();
+
+  // adopt it, so that join() can find it.
+  acquire(&wait_lock);
+  if((np = findproc(tid)) == 0){
+    release(&wait_lock);
+    return -1;
+  }
+  if(np->tg != p->tg || np == p){
+    release(&np->lock);
+    release(&wait_lock);
+    return -1;
+  }
+  np->parent = p;
+  release(&np->lock);
+  release(&wait_lock);
+
+  kill(tid);
+  return join(tid) == tid ? 0 : -1;
+}
+
+// Is there a process on any run queue? Peeks without locks.
+static int
+runqpending(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    if(__atomic_load_n(&runq[i].n, __ATOMIC_RELAXED) > 0)
+      return 1;
+  return 0;
+}
+
+// Nothing to run: stall the hart in wfi until an interrupt,
+// rather than spin. CPUs other than 0 also stop their ticks,
+// since there is nothing to preempt; CPU 0 keeps them to count
+// ticks. runqput() sends an ipi() to wake an idle CPU.
+static void
+idle(struct cpu *c, int id)
+{
+  intr_off();
+  c->idle = 1;
+  __sync_synchronize();
+  // look again, now that runqput() will see c->idle: a process
+  // queued before then would not have interrupted this CPU.
+  if(!runqpending()){
+    // an idle CPU is in no RCU read section; the scheduler
+    // loop sets rcuepoch again once it wakes.
+    __atomic_store_n(&c->rcuepoch, RCU_IDLE, __ATOMIC_RELEASE);
+    if(id != 0)
+      timerstop();
+    wfi();
+    if(id != 0)
+      timerstart();
+  }
+  c->idle = 0;
+  // the scheduler turns interrupts back on, to take
+  // whichever one ended the wfi.
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
+//  - choose a process to run, from this CPU's run queue,
+//    or stolen from another CPU's queue if this one is empty.
 //  - swtch to start running that process.
 //  - eventually that process transfers control
 //    via swtch back to the scheduler.
@@ -439,28 +1315,51 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int id = cpuid();
+  uint64 start;
   
   c->proc = 0;
   for(;;){
+    rcuquiesce(c);
+
+    if(__atomic_load_n(&boostpending, __ATOMIC_RELAXED) &&
+       __sync_lock_test_and_set(&boostpending, 0))
+      prioboost();
+
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
+    if((p = runqget(id)) == 0){
+      for(int i = 1; i < NCPU; i++)
+        if((p = runqget((id + i) % NCPU)) != 0)
+          break;
+      if(p == 0){
+        idle(c, id);
+        continue;
       }
-      release(&p->lock);
     }
+
+    acquire(&p->lock);
+    if(p->state == RUNNABLE) {
+      // Switch to chosen process.  It is the process's job
+      // to release its lock and then reacquire it
+      // before jumping back to us.
+      p->state = RUNNING;
+      p->cpu = id;
+      c->proc = p;
+      c->mark.cycles = r_cycle();
+      c->mark.instret = r_instret();
+      c->mark.stime = start = r_time();
+      TRACE(TR_RUN, p->prio, 0);
+      swtch(&c->context, &p->context);
+
+      // Process is done running for now.
+      // It should have changed its p->state before coming back.
+      perfcharge(p, c);
+      chargeprio(p, r_time() - start);
+      c->proc = 0;
+    }
+    release(&p->lock);
   }
 }
 
@@ -486,6 +1385,7 @@ sched(void)
   if(intr_get())
     panic("sched interruptible");
 
+  TRACE(TR_SWITCH, p->state, (uint64)p->chan);
   intena = mycpu()->intena;
   swtch(&p->context, &mycpu()->context);
   mycpu()->intena = intena;
@@ -497,7 +1397,21 @@ yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
-  p->state = RUNNABLE;
+  setrunnable(p);
+  p->use.nvcsw++;
+  sched();
+  release(&p->lock);
+}
+
+// Give up the CPU because a timer interrupt says its time
+// is up, rather than because it chose to.
+void
+preempt(void)
+{
+  struct proc *p = myproc();
+  acquire(&p->lock);
+  setrunnable(p);
+  p->use.nivcsw++;
   sched();
   release(&p->lock);
 }
@@ -529,21 +1443,32 @@ void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct sleepq *sq = sleepqof(chan);
   
-  // Must acquire p->lock in order to
-  // change p->state and then call sched.
-  // Once we hold p->lock, we can be
+  // Must acquire chan's sleep queue lock and p->lock in
+  // order to join the queue, change p->state and then
+  // call sched. Once we hold them, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
+  // (wakeup locks the sleep queue, then p->lock),
   // so it's okay to release lk.
 
+  acquire(&sq->lock);
   acquire(&p->lock);  //DOC: sleeplock1
-  release(lk);
 
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->sqnext = 0;
+  if(sq->tail)
+    sq->tail->sqnext = p;
+  else
+    sq->head = p;
+  sq->tail = p;
 
+  release(lk);
+  release(&sq->lock);
+
+  p->use.nvcsw++;
   sched();
 
   // Tidy up.
@@ -554,46 +1479,249 @@ sleep(void *chan, struct spinlock *lk)
   acquire(lk);
 }
 
+// Wake up the n processes that have slept longest on chan,
+// and return how many were woken.
+// Only looks at the processes on chan's sleep queue.
+// Must be called without any p->lock.
+int
+wakeupn(void *chan, int n)
+{
+  struct sleepq *sq = sleepqof(chan);
+  struct proc *p, *prev, *next;
+  int woken = 0;
+
+  // peek without the lock: a sleeper on chan joins the queue
+  // before it releases the lock it passed to sleep(), which
+  // the caller of wakeup() holds now, so it is on the queue.
+  // sleepers on other channels hashed to sq change head under
+  // us, so load it once, as an atomic.
+  if(__atomic_load_n(&sq->head, __ATOMIC_ACQUIRE) == 0)
+    return 0;
+
+  acquire(&sq->lock);
+  prev = 0;
+  for(p = sq->head; p != 0 && woken < n; p = next){
+    next = p->sqnext;
+    if(p->chan != chan){
+      prev = p;
+      continue;
+    }
+    acquire(&p->lock);
+    sleepqremove(sq, prev, p);
+    setrunnable(p);
+    release(&p->lock);
+    woken++;
+  }
+  release(&sq->lock);
+  return woken;
+}
+
 // Wake up all processes sleeping on chan.
 // Must be called without any p->lock.
 void
 wakeup(void *chan)
 {
-  struct proc *p;
+  wakeupn(chan, NPROC);
+}
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    if(p != myproc()){
-      acquire(&p->lock);
-      if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
+// Futexes: a thread can block until another thread changes
+// an int in memory that they share. Waiters sleep on the
+// kernel address of the int's physical memory, which is
+// the same for every thread that maps it, and is never the
+// same for two address spaces: the user address alone would
+// let a futexwake() in one process wake waiters on an
+// unrelated int at the same address in another.
+
+// Return the sleep channel for the int at user address uaddr,
+// and the lock that protects it, or 0 if uaddr is not valid.
+static void*
+futexchan(uint64 uaddr, struct spinlock **lkp)
+{
+  uint64 pa;
+
+  if(uaddr % sizeof(int) != 0)
+    return 0;
+  if((pa = walkaddr(myproc()->pagetable, PGROUNDDOWN(uaddr))) == 0)
+    return 0;
+  pa += uaddr % PGSIZE;
+  *lkp = &futexlock[(pa / sizeof(int)) % NFUTEXLOCK];
+  return (void*)pa;
+}
+
+// If the int at user address uaddr still holds val,
+// sleep until futexwake() on the same int.
+// Return 0 when woken, -1 if the value differed.
+int
+futexwait(uint64 uaddr, int val)
+{
+  struct proc *p = myproc();
+  struct spinlock *lk;
+  void *chan;
+  int cur;
+
+  if((chan = futexchan(uaddr, &lk)) == 0)
+    return -1;
+
+  // a waker changes the int before it takes lk, so checking the
+  // int and sleeping under lk cannot miss the wakeup.
+  acquire(lk);
+  if(copyin(p->pagetable, (char *)&cur, uaddr, sizeof(cur)) < 0 ||
+     cur != val || p->killed){
+    release(lk);
+    return -1;
+  }
+  sleep(chan, lk);
+  release(lk);
+  return 0;
+}
+
+// Wake up to n threads waiting in futexwait() on the
+// int at user address uaddr. Return how many were woken.
+int
+futexwake(uint64 uaddr, int n)
+{
+  struct spinlock *lk;
+  void *chan;
+  int woken;
+
+  if((chan = futexchan(uaddr, &lk)) == 0)
+    return -1;
+  acquire(lk);
+  woken = wakeupn(chan, n);
+  release(lk);
+  return woken;
+}
+
+// Mark p killed, and wake it from sleep().
+// p->lock must be held; it is released.
+static void
+killproc(struct proc *p)
+{
+  void *chan;
+
+  p->killed = 1;
+  // Wake process from sleep(). Taking its sleep queue's
+  // lock means dropping p->lock first, so check again
+  // that it is still asleep on the same channel.
+  while(p->state == SLEEPING){
+    chan = p->chan;
+    release(&p->lock);
+    struct sleepq *sq = sleepqof(chan);
+    acquire(&sq->lock);
+    acquire(&p->lock);
+    if(p->state == SLEEPING && p->chan == chan){
+      struct proc *prev = 0;
+      for(struct proc *q = sq->head; q != p; q = q->sqnext)
+        prev = q;
+      sleepqremove(sq, prev, p);
+      setrunnable(p);
     }
+    release(&sq->lock);
   }
+  release(&p->lock);
 }
 
-// Kill the process with the given pid.
-// The victim won't exit until it tries to return
+// Kill the process with the given pid, and every other
+// thread of its thread group.
+// The victims won't exit until they try to return
 // to user space (see usertrap() in trap.c).
 int
 kill(int pid)
 {
   struct proc *p;
+  struct tgroup *tg;
 
+  if((p = findproc(pid)) == 0)
+    return -1;
+  tg = p->tg;
+  killproc(p);
+  // tg is only compared, never followed: it may be
+  // freed once the threads are gone.
   for(p = proc; p < &proc[NPROC]; p++){
+    if(__atomic_load_n(&p->tg, __ATOMIC_RELAXED) != tg || p->pid == pid)
+      continue;
     acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
+    if(p->tg == tg && p->state != UNUSED && p->state != ZOMBIE && !p->killed)
+      killproc(p);
+    else
       release(&p->lock);
-      return 0;
-    }
-    release(&p->lock);
   }
-  return -1;
+  return 0;
+}
+
+// Set the base priority of process pid (0 means the caller),
+// where 0 is the highest of the NPRIO levels.
+int
+setpriority(int pid, int nice)
+{
+  struct proc *p;
+
+  if(nice < 0 || nice >= NPRIO)
+    return -1;
+  if(pid == 0)
+    pid = myproc()->pid;
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->nice = p->level = nice;
+  p->ran = 0;
+  reprio(p);
+  release(&p->lock);
+  return 0;
+}
+
+// Return the base priority of process pid (0 means the caller).
+int
+getpriority(int pid)
+{
+  struct proc *p;
+  int nice;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+  if((p = findproc(pid)) == 0)
+    return -1;
+  nice = p->nice;
+  release(&p->lock);
+  return nice;
+}
+
+// Priority inheritance for sleep locks: a process that
+// has to wait for lk, held by p, lends p its priority,
+// so that p is not starved while the waiter blocks.
+// Lending goes one step only: if p is itself waiting for
+// another sleep lock, its holder is not lent the priority.
+// Following the chain would mean taking the next lock's
+// spinlock while holding lk->lk, in no fixed order.
+// Called by the waiter with lk->lk held; p->lock must not be.
+void
+lendprio(struct proc *p, struct sleeplock *lk, int prio)
+{
+  acquire(&p->lock);
+  if(prio < lk->waitprio)
+    lk->waitprio = prio;
+  if(prio < p->lent){
+    p->lent = prio;
+    reprio(p);
+  }
+  release(&p->lock);
+}
+
+// The current process has released a sleep lock: keep only
+// the priority lent to it through the sleep locks it still
+// holds. lk->waitprio changes under the holder's p->lock.
+void
+unlendprio(void)
+{
+  struct proc *p = myproc();
+  struct sleeplock *lk;
+
+  acquire(&p->lock);
+  p->lent = NPRIO;
+  for(lk = p->held; lk; lk = lk->next)
+    if(lk->waitprio < p->lent)
+      p->lent = lk->waitprio;
+  reprio(p);
+  release(&p->lock);
 }
 
 // Copy to either a user address, or kernel address,
@@ -654,3 +1782,51 @@ procdump(void)
     printf("\n");
   }
 }
+
+// Copy the processes in the table, up to n of them, to addr,
+// an array of struct procstat. The time a running process has
+// had since the scheduler last charged it is included, as
+// kernel time until usertrap() sorts out the user part.
+// Returns the number copied, or -1.
+int
+procstat(uint64 addr, int n)
+{
+  struct procstat ps;
+  struct proc *p;
+  struct cpu *c;
+  int i = 0;
+
+  for(p = proc; p < &proc[NPROC] && i < n; p++){
+    acquire(&wait_lock);
+    acquire(&p->lock);
+    if(p->state == UNUSED || p->tg == 0){
+      release(&p->lock);
+      release(&wait_lock);
+      continue;
+    }
+    memset(&ps, 0, sizeof(ps));
+    ps.pid = p->pid;
+    ps.ppid = p->parent ? p->parent->pid : 0;
+    ps.state = p->state;
+    ps.cpu = p->cpu;
+    ps.prio = p->prio;
+    ps.nice = p->nice;
+    safestrcpy(ps.name, p->name, sizeof(ps.name));
+    ps.perf = p->perf;
+    ps.use = p->use;
+    if(p->state == RUNNING){
+      c = &cpus[p->cpu];
+      ps.perf.stime += r_time() - c->mark.stime;
+    }
+    acquire(&p->tg->lock);
+    ps.sz = p->tg->sz;
+    ps.nthread = p->tg->nthread;
+    release(&p->tg->lock);
+    release(&p->lock);
+    release(&wait_lock);
+    if(copyout(myproc()->pagetable, addr + i*sizeof(ps), (char*)&ps, sizeof(ps)) < 0)
+      return -1;
+    i++;
+  }
+  return i;
+}
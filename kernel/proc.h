@@ -18,12 +18,37 @@ struct context {
   uint64 s11;
 };
 
+// what perfstat() reports about a process.
+struct perfstat {
+  uint64 cycles;    // cycle CSR counts while it ran
+  uint64 instret;   // instructions retired while it ran
+  uint64 utime;     // time CSR cycles spent in user space
+  uint64 stime;     // time CSR cycles spent in the kernel
+};
+
+// what a process has used, besides time.
+struct usage {
+  uint64 nvcsw;       // times it slept or yielded
+  uint64 nivcsw;      // times a timer interrupt preempted it
+  uint64 nbread;      // blocks it read from disk
+  uint64 nbwrite;     // blocks it wrote to disk
+  uint64 npiperead;   // bytes it read from pipes
+  uint64 npipewrite;  // bytes it wrote to pipes
+};
+
 // Per-CPU state.
 struct cpu {
   struct proc *proc;          // The process running on this cpu, or null.
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  int idle;                   // In wfi, waiting for work? See idle().
+  uint64 rcuepoch;            // rcuclock when last in the scheduler, see rcudone()
+  struct perfstat mark;       // counters when it last switched to a process
+  uint64 tlbgen;              // tlbgen when it last flushed its TLB
+#ifdef MCSLOCK
+  struct mcsnode mcs[NMCS];   // queue nodes for the spinlocks it holds
+#endif
 };
 
 extern struct cpu cpus[NCPU];
@@ -78,6 +103,9 @@ struct trapframe {
   /* 264 */ uint64 t4;
   /* 272 */ uint64 t5;
   /* 280 */ uint64 t6;
+  /* 288 */ uint64 kernel_fast;   // usertrapfast()
+  /* 296 */ uint64 fastmask;      // bit n: system call n may take the fast path
+  /* 304 */ uint64 kernel_flush;  // uservec must flush the TLB
 };
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
@@ -92,17 +120,64 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int cpu;                     // CPU whose run queue it joins when runnable
+  int nice;                    // Base priority, 0 (highest) to NPRIO-1
+  int level;                   // MLFQ level, nice to NPRIO-1; see chargeprio()
+  int prio;                    // Effective priority, picks the run queue list
+  int lent;                    // Best priority lent through held sleep locks
+  uint64 ran;                  // time CSR cycles run at level
+
+  // the run queue's lock must be held when using this:
+  struct proc *rqnext;         // Next on a per-CPU run queue
+
+  // the sleep queue's lock must be held when using this:
+  struct proc *sqnext;         // Next on the sleep queue of chan
+
+  // private to the process; see unlendprio().
+  struct sleeplock *held;      // Sleep locks it holds, most recent first
 
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
 
+  // pid_lock must be held to change these; see findproc().
+  struct proc *pidnext;        // Next in the pid hash bucket
+  int retired;                 // Freed, maybe still seen by a findproc()
+  uint64 epoch;                // rcuretire() when freed
+
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
-  uint64 sz;                   // Size of process memory (bytes)
-  pagetable_t pagetable;       // User page table
+  struct tgroup *tg;           // Memory, files and cwd, shared with threads
+  pagetable_t pagetable;       // User page table, a copy of tg->pagetable
   struct trapframe *trapframe; // data page for trampoline.S
+  uint64 tfva;                 // User address of trapframe
   struct context context;      // swtch() here to run process
+  char name[16];               // Process name (debugging)
+
+  // counted on the CPU running the process; see perfcharge().
+  struct perfstat perf;        // This thread's, plus threads it joined
+  struct perfstat cperf;       // Children's that it has waited for
+  struct usage use;            // Counted by the process itself
+  uint64 umark;                // time CSR when it last entered user space
+};
+
+// The state shared by the threads of a process.
+// fork() starts a new thread group; clone() adds
+// a thread to the caller's group.
+struct tgroup {
+  struct spinlock lock;
+
+  // lock must be held when using these, and when
+  // changing the mappings in pagetable:
+  int ref;                     // procs using pagetable, freed or not
+  int nthread;                 // threads that have not exited yet
+  uint64 sz;                   // Size of process memory (bytes)
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
-  char name[16];               // Process name (debugging)
+
+  pagetable_t pagetable;       // User page table
+  int asid;                    // Its address space ID, or 0 without ASIDs
+  struct vdsoproc *vdso;       // Page mapped at VDSOPROC
+  uint64 ring;                 // User address of struct ring, or 0
+  int ringbusy;                // A thread is taking submissions
+  int poller;                  // Pid of the RING_SQPOLL thread, or 0
 };
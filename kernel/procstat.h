@@ -0,0 +1,16 @@
+// One process, as copied out by the procstat() system call.
+// Needs proc.h.
+
+struct procstat {
+  int pid;
+  int ppid;             // 0 if it has no parent
+  int state;            // enum procstate in proc.h
+  short cpu;            // CPU it last ran on
+  short prio;           // run queue it is on, or would join
+  int nice;
+  int nthread;          // threads in its group
+  char name[16];
+  uint64 sz;            // bytes of user memory
+  struct perfstat perf; // cycles, instructions and time, to date
+  struct usage use;
+};
@@ -0,0 +1,155 @@
+//
+// sampling profiler.
+//
+// while profiling, usertrap() and kerneltrap() call profuser()
+// or profkernel() on each clock tick, which put a sample in
+// this CPU's ring. a full ring drops samples until prof()
+// reads it. kernel and user code keep frame pointers (-fno-
+// omit-frame-pointer), so the stack walk follows s0: the
+// return address is at fp-8 and the caller's fp at fp-16.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "prof.h"
+
+struct profring {
+  struct spinlock lock;
+  uint head;                   // samples [tail, head) are unread
+  uint tail;
+  uint64 dropped;
+  struct profsample s[NPROFSAMPLE];
+} __attribute__ ((aligned (64))) profring[NCPU];
+
+int profiling;
+
+void
+profinit(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    initlock(&profring[i].lock, "prof");
+}
+
+// Fill in the parts of s that describe this CPU and process.
+// Interrupts are off.
+static void
+profhead(struct profsample *s, struct proc *p, int user)
+{
+  memset(s, 0, sizeof(*s));
+  s->cpu = cpuid();
+  s->user = user;
+  if(p){
+    s->pid = p->pid;
+    safestrcpy(s->name, p->name, sizeof(s->name));
+  }
+}
+
+static void
+profput(struct profsample *s)
+{
+  struct profring *r = &profring[s->cpu];
+
+  acquire(&r->lock);
+  if(r->head - r->tail == NPROFSAMPLE){
+    r->dropped++;
+  } else {
+    r->s[r->head % NPROFSAMPLE] = *s;
+    r->head++;
+  }
+  release(&r->lock);
+}
+
+// A tick interrupted kernel code at pc, with frame pointer fp.
+// The stack walk stays within the kernel stack page of base,
+// an address in kerneltrap()'s frame, and only goes up it.
+void
+profkernel(uint64 pc, uint64 fp, uint64 base)
+{
+  struct profsample s;
+  uint64 lo = PGROUNDDOWN(base), hi = lo + PGSIZE;
+
+  profhead(&s, myproc(), 0);
+  s.pc[s.depth++] = pc;
+  while(s.depth < PROFDEPTH && fp > base && fp <= hi && fp % 8 == 0){
+    s.pc[s.depth++] = *(uint64*)(fp - 8);
+    if(*(uint64*)(fp - 16) <= fp)
+      break;
+    fp = *(uint64*)(fp - 16);
+  }
+  profput(&s);
+}
+
+// A tick interrupted p in user space.
+void
+profuser(struct proc *p)
+{
+  struct profsample s;
+  uint64 fp = p->trapframe->s0, frame[2];
+
+  profhead(&s, p, 1);
+  s.pc[s.depth++] = p->trapframe->epc;
+  while(s.depth < PROFDEPTH && fp != 0 && fp % 8 == 0){
+    // frame[1] is the return address, frame[0] the caller's fp.
+    if(copyin(p->pagetable, (char*)frame, fp - 16, sizeof(frame)) < 0)
+      break;
+    s.pc[s.depth++] = frame[1];
+    if(frame[0] <= fp)
+      break;
+    fp = frame[0];
+  }
+  profput(&s);
+}
+
+// The prof() system call: start or stop sampling, or copy
+// up to n samples to user address addr.
+int
+prof(int cmd, uint64 addr, int n)
+{
+  struct profring *r;
+  struct profsample s;
+  uint64 dropped = 0;
+  int i = 0;
+
+  switch(cmd){
+  case PROF_START:
+    for(r = profring; r < &profring[NCPU]; r++){
+      acquire(&r->lock);
+      r->head = r->tail = 0;
+      r->dropped = 0;
+      release(&r->lock);
+    }
+    profiling = 1;
+    return 0;
+  case PROF_STOP:
+    profiling = 0;
+    for(r = profring; r < &profring[NCPU]; r++){
+      acquire(&r->lock);
+      dropped += r->dropped;
+      release(&r->lock);
+    }
+    return dropped;
+  case PROF_READ:
+    for(r = profring; r < &profring[NCPU] && i < n; r++){
+      for(;;){
+        acquire(&r->lock);
+        if(r->tail == r->head || i >= n){
+          release(&r->lock);
+          break;
+        }
+        s = r->s[r->tail % NPROFSAMPLE];
+        r->tail++;
+        release(&r->lock);
+        if(copyout(myproc()->pagetable, addr + i*sizeof(s), (char*)&s, sizeof(s)) < 0)
+          return -1;
+        i++;
+      }
+    }
+    return i;
+  }
+  return -1;
+}
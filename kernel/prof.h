@@ -0,0 +1,19 @@
+// Sampling profiler: on each clock tick while profiling, a
+// CPU records where it was interrupted, and the call stack
+// found by following frame pointers. prof() reads them out.
+
+#define PROFDEPTH 8
+
+struct profsample {
+  int pid;              // 0 if the CPU was in the scheduler
+  short cpu;
+  short user;           // pc[] are user addresses
+  char name[16];        // the process's name, to find its symbols
+  int depth;            // entries of pc[] in use
+  uint64 pc[PROFDEPTH]; // the interrupted pc, then return addresses
+};
+
+// prof() commands
+#define PROF_START 1    // discard old samples and start sampling
+#define PROF_STOP  2    // stop; returns the number of samples dropped
+#define PROF_READ  3    // take up to n samples; returns how many
@@ -1,5 +1,11 @@
 //
-// ramdisk that uses the disk image loaded by qemu -initrd fs.img
+// ramdisk that serves the file system image linked into
+// the kernel by "make RAMDISK=1" (ld -b binary fs.img).
+//
+// the image lives in kernel memory, so bread() does not
+// copy a block into the buffer cache: it points b->data
+// straight at the block inside the image, and writes
+// through the buffer cache land in the image directly.
 //
 
 #include "types.h"
@@ -12,34 +18,40 @@
 #include "fs.h"
 #include "buf.h"
 
+// the linker names these after the fs.img input file.
+extern char _binary_fs_img_start[], _binary_fs_img_end[];
+
+static uint nblocks;  // size of the image, in blocks
+
 void
 ramdiskinit(void)
 {
+  nblocks = (_binary_fs_img_end - _binary_fs_img_start) / BSIZE;
+  if(nblocks == 0)
+    panic("ramdiskinit: no image");
+  if((uint64)_binary_fs_img_start % sizeof(uint64))
+    panic("ramdiskinit: image not aligned");
 }
 
-// If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
-// Else if B_VALID is not set, read buf from disk, set B_VALID.
+// Read or write b's block.
+// A read re-points b->data at the block in the image (zero-copy),
+// so a later write only has to copy if b->data points elsewhere.
 void
-ramdiskrw(struct buf *b)
+ramdiskrw(struct buf *b, int write)
 {
   if(!holdingsleep(&b->lock))
     panic("ramdiskrw: buf not locked");
-  if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
-    panic("ramdiskrw: nothing to do");
-
-  if(b->blockno >= FSSIZE)
+  if(b->dev != ROOTDEV)
+    panic("ramdiskrw: bad dev");
+  if(b->blockno >= nblocks)
     panic("ramdiskrw: blockno too big");
 
-  uint64 diskaddr = b->blockno * BSIZE;
-  char *addr = (char *)RAMDISK + diskaddr;
+  uchar *addr = (uchar *)_binary_fs_img_start + (uint64)b->blockno * BSIZE;
 
-  if(b->flags & B_DIRTY){
-    // write
-    memmove(addr, b->data, BSIZE);
-    b->flags &= ~B_DIRTY;
+  if(write){
+    if(b->data != addr)
+      memmove(addr, b->data, BSIZE);
   } else {
-    // read
-    memmove(b->data, addr, BSIZE);
-    b->flags |= B_VALID;
+    b->data = addr;
   }
 }
@@ -0,0 +1,319 @@
+//
+// Submission/completion rings (see ring.h).
+//
+// the rings live in the process's own memory; the kernel
+// reads submissions with copyin() and posts completions with
+// copyout(), and carries them out with fileread() and
+// filewrite(), as read() and write() would. a process has at
+// most one ring, registered with ring_setup().
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "timer.h"
+#include "ring.h"
+
+// byte offset of field f in struct ring.
+#define RINGOFF(f) ((uint64)&((struct ring *)0)->f)
+
+// how long an idle RING_SQPOLL thread naps between polls,
+// and how many empty polls before it sleeps until woken.
+#define POLLNAP (MTIME_HZ / 10000)
+#define POLLIDLE 100
+
+static int
+getfield(pagetable_t pagetable, uint64 r, uint64 off, uint *v)
+{
+  return copyin(pagetable, (char *)v, r + off, sizeof(*v));
+}
+
+// store v, after everything stored before it.
+static int
+putfield(pagetable_t pagetable, uint64 r, uint64 off, uint v)
+{
+  __sync_synchronize();
+  return copyout(pagetable, r + off, (char *)&v, sizeof(v));
+}
+
+// one thread at a time takes submissions from the ring.
+static void
+ringlock(struct tgroup *tg)
+{
+  acquire(&tg->lock);
+  while(tg->ringbusy)
+    sleep(&tg->ringbusy, &tg->lock);
+  tg->ringbusy = 1;
+  release(&tg->lock);
+}
+
+static void
+ringunlock(struct tgroup *tg)
+{
+  acquire(&tg->lock);
+  tg->ringbusy = 0;
+  wakeup(&tg->ringbusy);
+  release(&tg->lock);
+}
+
+// the file open as fd, with a reference that keeps it
+// open even if another thread closes fd meanwhile.
+static struct file*
+ringfile(struct tgroup *tg, int fd)
+{
+  struct file *f = 0;
+
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  acquire(&tg->lock);
+  if(tg->ofile[fd])
+    f = filedup(tg->ofile[fd]);
+  release(&tg->lock);
+  return f;
+}
+
+// carry out one submission; return its result.
+static int
+ringop(struct tgroup *tg, struct sqe *e)
+{
+  struct file *f;
+  int r;
+
+  switch(e->op){
+  case RING_NOP:
+    return 0;
+  case RING_READ:
+  case RING_WRITE:
+    if(e->n < 0 || (f = ringfile(tg, e->fd)) == 0)
+      return -1;
+    if(e->op == RING_READ)
+      r = fileread(f, e->addr, e->n);
+    else
+      r = filewrite(f, e->addr, e->n);
+    fileclose(f);
+    return r;
+  case RING_CLOSE:
+    if(e->fd < 0 || e->fd >= NOFILE)
+      return -1;
+    acquire(&tg->lock);
+    f = tg->ofile[e->fd];
+    tg->ofile[e->fd] = 0;
+    release(&tg->lock);
+    if(f == 0)
+      return -1;
+    fileclose(f);
+    return 0;
+  }
+  return -1;
+}
+
+// Carry out the submissions queued on p's ring, posting a
+// completion for each, until the submission ring is empty
+// or the completion ring is full.
+// Returns the number taken, or -1 if the ring is not readable.
+// The caller must hold ringlock().
+static int
+ringrun(struct proc *p, uint64 r)
+{
+  pagetable_t pagetable = p->pagetable;
+  uint sqhead, sqtail, cqhead, cqtail;
+  struct sqe e;
+  struct cqe c;
+  int n = 0;
+
+  if(getfield(pagetable, r, RINGOFF(sqhead), &sqhead) < 0 ||
+     getfield(pagetable, r, RINGOFF(sqtail), &sqtail) < 0 ||
+     getfield(pagetable, r, RINGOFF(cqtail), &cqtail) < 0)
+    return -1;
+  // read sqes only after the sqtail that covers them.
+  __sync_synchronize();
+
+  while(sqhead != sqtail){
+    if(getfield(pagetable, r, RINGOFF(cqhead), &cqhead) < 0)
+      return -1;
+    if(cqtail - cqhead >= RINGSIZE)
+      break;
+    if(copyin(pagetable, (char *)&e, r + RINGOFF(sq[sqhead % RINGSIZE]), sizeof(e)) < 0)
+      return -1;
+
+    c.data = e.data;
+    c.res = ringop(p->tg, &e);
+    c.pad = 0;
+
+    if(copyout(pagetable, r + RINGOFF(cq[cqtail % RINGSIZE]), (char *)&c, sizeof(c)) < 0 ||
+       putfield(pagetable, r, RINGOFF(cqtail), ++cqtail) < 0 ||
+       putfield(pagetable, r, RINGOFF(sqhead), ++sqhead) < 0)
+      return -1;
+    n++;
+  }
+  return n;
+}
+
+// Sleep while p's submission ring at r is empty, until
+// ring_enter() wakes p, or for at most cycles.
+static void
+ringwait(struct proc *p, uint64 r, uint64 cycles)
+{
+  struct tgroup *tg = p->tg;
+  struct timer t;
+  uint sqhead, sqtail;
+
+  if(cycles != MTIME_NEVER){
+    t.when = timenow() + cycles;
+    t.chan = &tg->ring;
+    t.lk = &tg->lock;
+    timeradd(&t);
+  }
+
+  // a process that queues a submission and then calls
+  // ring_enter() wakes us once we sleep and so release
+  // tg->lock.
+  acquire(&tg->lock);
+  if(getfield(p->pagetable, r, RINGOFF(sqhead), &sqhead) < 0 ||
+     getfield(p->pagetable, r, RINGOFF(sqtail), &sqtail) < 0 ||
+     sqhead == sqtail){
+    if(tg->nthread > 1 && !p->killed && !(cycles != MTIME_NEVER && t.fired))
+      sleep(&tg->ring, &tg->lock);
+  }
+  release(&tg->lock);
+
+  if(cycles != MTIME_NEVER)
+    timerdel(&t);
+}
+
+// The body of a RING_SQPOLL thread, which takes submissions
+// as the process queues them, so that it needs no system calls.
+// While the ring is empty it naps for POLLNAP between polls;
+// after POLLIDLE empty polls it sets RING_NEEDWAKE and sleeps
+// until ring_enter(), or the exit of the process's last thread.
+static void
+ringpoller(void)
+{
+  struct proc *p = myproc();
+  struct tgroup *tg = p->tg;
+  uint64 r = tg->ring;
+  int n, idle = 0;
+
+  // Still holding p->lock from scheduler.
+  release(&p->lock);
+
+  for(;;){
+    acquire(&tg->lock);
+    if(tg->nthread == 1 || p->killed){
+      tg->poller = 0;
+      release(&tg->lock);
+      exit(0);
+    }
+    release(&tg->lock);
+
+    ringlock(tg);
+    n = ringrun(p, r);
+    ringunlock(tg);
+    if(n > 0){
+      idle = 0;
+      continue;
+    }
+    if(n == 0 && ++idle < POLLIDLE){
+      ringwait(p, r, POLLNAP);
+      continue;
+    }
+
+    // a process that queues a submission and then sees
+    // RING_NEEDWAKE calls ring_enter().
+    putfield(p->pagetable, r, RINGOFF(flags), RING_NEEDWAKE);
+    __sync_synchronize();
+    ringwait(p, r, MTIME_NEVER);
+    putfield(p->pagetable, r, RINGOFF(flags), 0);
+    idle = 0;
+  }
+}
+
+// Register the struct ring at user address r as the
+// process's ring, with a poller thread if flags has
+// RING_SQPOLL. Returns 0, or -1.
+int
+ringsetup(uint64 r, int flags)
+{
+  struct proc *p = myproc();
+  struct tgroup *tg = p->tg;
+  uint zero[6];
+
+  if(r % sizeof(uint64) != 0)
+    return -1;
+  memset(zero, 0, sizeof(zero));
+  if(copyout(p->pagetable, r, (char *)zero, sizeof(zero)) < 0)
+    return -1;
+
+  acquire(&tg->lock);
+  if(tg->ring){
+    release(&tg->lock);
+    return -1;
+  }
+  tg->ring = r;
+  release(&tg->lock);
+
+  if(flags & RING_SQPOLL){
+    int pid = kthread(ringpoller, "ringpoll");
+    acquire(&tg->lock);
+    if(pid < 0)
+      tg->ring = 0;
+    else
+      tg->poller = pid;
+    release(&tg->lock);
+    if(pid < 0)
+      return -1;
+  }
+  return 0;
+}
+
+// Stop the process's RING_SQPOLL thread, if it has one, and
+// free it, dropping its reference to the thread group.
+// For exec(): the poller is not a thread the program made.
+// Returns 0, or -1.
+int
+ringstop(void)
+{
+  struct tgroup *tg = myproc()->tg;
+  int pid;
+
+  acquire(&tg->lock);
+  pid = tg->poller;
+  release(&tg->lock);
+  if(pid == 0)
+    return 0;
+  return reapthread(pid);
+}
+
+// Take the submissions queued on the process's ring, or wake
+// its poller to do so. Returns the number taken, or -1.
+int
+ringenter(void)
+{
+  struct proc *p = myproc();
+  struct tgroup *tg = p->tg;
+  int n;
+
+  acquire(&tg->lock);
+  if(tg->ring == 0){
+    release(&tg->lock);
+    return -1;
+  }
+  if(tg->poller){
+    wakeup(&tg->ring);
+    release(&tg->lock);
+    return 0;
+  }
+  release(&tg->lock);
+
+  ringlock(tg);
+  n = ringrun(p, tg->ring);
+  ringunlock(tg);
+  return n;
+}
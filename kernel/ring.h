@@ -0,0 +1,46 @@
+// A submission ring and a completion ring, shared between a
+// process and the kernel, so that many reads and writes cost
+// one system call, or none with a RING_SQPOLL kernel thread.
+// See kernel/ring.c and user/ring.c.
+
+#define RINGSIZE 64        // entries in each ring, a power of two
+
+// sqe ops
+#define RING_NOP   0
+#define RING_READ  1
+#define RING_WRITE 2
+#define RING_CLOSE 3
+
+// ring_setup() flags
+#define RING_SQPOLL 0x1    // a kernel thread takes submissions
+
+// struct ring flags, set by the kernel
+#define RING_NEEDWAKE 0x1  // the poller sleeps; ring_enter() wakes it
+
+// a submission.
+struct sqe {
+  int op;
+  int fd;
+  uint64 addr;             // buffer for RING_READ and RING_WRITE
+  int n;
+  int pad;
+  uint64 data;             // copied to the matching cqe
+};
+
+// a completion.
+struct cqe {
+  uint64 data;
+  int res;                 // what read(), write() or close() returns
+  int pad;
+};
+
+struct ring {
+  uint sqhead;             // next sqe for the kernel to take
+  uint sqtail;             // next sqe for the user to fill
+  uint cqhead;             // next cqe for the user to take
+  uint cqtail;             // next cqe for the kernel to fill
+  uint flags;
+  uint pad;
+  struct sqe sq[RINGSIZE];
+  struct cqe cq[RINGSIZE];
+};
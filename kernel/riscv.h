@@ -198,6 +198,12 @@ w_pmpaddr0(uint64 x)
 
 #define MAKE_SATP(pagetable) (SATP_SV39 | (((uint64)pagetable) >> 12))
 
+// the address space ID field: TLB entries made under one
+// ASID are not used under another, so switching between
+// page tables with different ASIDs needs no sfence.vma.
+#define SATP_ASID(asid) (((uint64)(asid) & 0xffff) << 44)
+#define SATP_ASIDOF(satp) (((satp) >> 44) & 0xffff)
+
 // supervisor address translation and protection;
 // holds the address of the page table.
 static inline void 
@@ -260,6 +266,25 @@ r_mcounteren()
   return x;
 }
 
+// Supervisor-mode Counter-Enable
+static inline void 
+w_scounteren(uint64 x)
+{
+  asm volatile("csrw scounteren, %0" : : "r" (x));
+}
+
+static inline uint64
+r_scounteren()
+{
+  uint64 x;
+  asm volatile("csrr %0, scounteren" : "=r" (x) );
+  return x;
+}
+
+#define COUNTEREN_CY (1L << 0) // cycle readable in the mode below
+#define COUNTEREN_TM (1L << 1) // time readable in the mode below
+#define COUNTEREN_IR (1L << 2) // instret readable in the mode below
+
 // machine-mode cycle counter
 static inline uint64
 r_time()
@@ -269,6 +294,24 @@ r_time()
   return x;
 }
 
+// clock cycles executed by this hart
+static inline uint64
+r_cycle()
+{
+  uint64 x;
+  asm volatile("csrr %0, cycle" : "=r" (x) );
+  return x;
+}
+
+// instructions retired by this hart
+static inline uint64
+r_instret()
+{
+  uint64 x;
+  asm volatile("csrr %0, instret" : "=r" (x) );
+  return x;
+}
+
 // enable device interrupts
 static inline void
 intr_on()
@@ -299,6 +342,15 @@ r_sp()
   return x;
 }
 
+// the frame pointer
+static inline uint64
+r_fp()
+{
+  uint64 x;
+  asm volatile("mv %0, s0" : "=r" (x) );
+  return x;
+}
+
 // read and write tp, the thread pointer, which holds
 // this core's hartid (core number), the index into cpus[].
 static inline uint64
@@ -323,6 +375,14 @@ r_ra()
   return x;
 }
 
+// wait for an interrupt: stall the hart until one
+// that is enabled in sie is pending, even if SIE is off.
+static inline void
+wfi()
+{
+  asm volatile("wfi");
+}
+
 // flush the TLB.
 static inline void
 sfence_vma()
@@ -0,0 +1,95 @@
+// Reader-writer spin locks, for tables that are searched far
+// more often than they are changed. Like spinlocks, they keep
+// interrupts off while held.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "rwlock.h"
+#include "riscv.h"
+#include "proc.h"
+#include "defs.h"
+
+#define RW_WRITER  0x80000000  // a writer holds the lock
+#define RW_WAITING 0x40000000  // a writer is waiting: hold off new readers
+#define RW_READERS 0x3fffffff  // the number of readers
+
+void
+initrwlock(struct rwlock *rw, char *name)
+{
+  rw->name = name;
+  rw->state = 0;
+  rw->cpu = 0;
+  rw->cls = findclass(name);
+}
+
+// Acquire rw for reading, once no writer holds it or waits.
+// Readers and writers are counted together under rw's class.
+void
+acquireread(struct rwlock *rw)
+{
+  uint64 start = 0;
+  uint s;
+
+  push_off();
+  for(;;){
+    s = __atomic_load_n(&rw->state, __ATOMIC_RELAXED);
+    if((s & (RW_WRITER|RW_WAITING)) == 0 &&
+       __sync_bool_compare_and_swap(&rw->state, s, s + 1))
+      break;
+    if(start == 0)
+      start = r_time();
+  }
+  __sync_synchronize();
+  lockcount(rw->cls, start != 0, start ? r_time() - start : 0, -1);
+}
+
+void
+releaseread(struct rwlock *rw)
+{
+  __sync_synchronize();
+  if((__sync_fetch_and_sub(&rw->state, 1) & RW_READERS) == 0)
+    panic("releaseread");
+  pop_off();
+}
+
+// Acquire rw for writing. Setting RW_WAITING stops new readers,
+// so that a stream of them cannot starve the writer.
+void
+acquirewrite(struct rwlock *rw)
+{
+  uint64 start = 0;
+  uint s;
+
+  push_off();
+  if(rw->cpu == mycpu())
+    panic("acquirewrite");
+  for(;;){
+    s = __atomic_load_n(&rw->state, __ATOMIC_RELAXED);
+    if((s & (RW_WRITER|RW_READERS)) == 0){
+      // RW_WAITING may be set, by this cpu or another writer;
+      // the winner clears it, and the others set it again.
+      if(__sync_bool_compare_and_swap(&rw->state, s, RW_WRITER))
+        break;
+    } else if((s & RW_WAITING) == 0){
+      __sync_fetch_and_or(&rw->state, RW_WAITING);
+    }
+    if(start == 0)
+      start = r_time();
+  }
+  __sync_synchronize();
+  rw->cpu = mycpu();
+  lockcount(rw->cls, start != 0, start ? r_time() - start : 0, -1);
+}
+
+void
+releasewrite(struct rwlock *rw)
+{
+  if(rw->cpu != mycpu() || (rw->state & RW_WRITER) == 0)
+    panic("releasewrite");
+  rw->cpu = 0;
+  __sync_synchronize();
+  __sync_fetch_and_and(&rw->state, ~RW_WRITER);
+  pop_off();
+}
@@ -0,0 +1,11 @@
+// Reader-writer spin lock: any number of readers, or one writer.
+struct rwlock {
+  uint state;        // RW_WRITER, RW_WAITING, and the reader count
+
+  // For debugging:
+  char *name;        // Name of lock.
+  struct cpu *cpu;   // The cpu holding it for writing.
+
+  // For lockstat():
+  struct lockclass *cls;  // its name's class, to count it under; or 0
+};
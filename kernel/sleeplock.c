@@ -16,28 +16,78 @@ initsleeplock(struct sleeplock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->pid = 0;
+  lk->proc = 0;
+  lk->waitprio = NPRIO;
+  lk->next = 0;
+  lk->cls = findclass(name);
+}
+
+// Is lk's holder running on another CPU? Then it will likely
+// release lk soon, and spinning is cheaper than two context
+// switches. Reads without locks: the answer is only a hint.
+static int
+holderrunning(struct sleeplock *lk)
+{
+  struct proc *p = __atomic_load_n(&lk->proc, __ATOMIC_RELAXED);
+
+  return p != 0 && p != myproc() &&
+         __atomic_load_n(&p->state, __ATOMIC_RELAXED) == RUNNING;
 }
 
 void
 acquiresleep(struct sleeplock *lk)
 {
+  uint64 start, spun = 0;
+  int contended = 0, slept = 0;
+
   acquire(&lk->lk);
   while (lk->locked) {
+    contended = 1;
+    if(!slept && spun < SLEEPSPIN && holderrunning(lk)){
+      // spin, with interrupts on, while the holder runs,
+      // for at most SLEEPSPIN cycles in all.
+      release(&lk->lk);
+      start = r_time();
+      while(__atomic_load_n(&lk->locked, __ATOMIC_RELAXED) && holderrunning(lk) &&
+            spun + (r_time() - start) < SLEEPSPIN)
+        ;
+      spun += r_time() - start;
+      acquire(&lk->lk);
+      continue;
+    }
+    lendprio(lk->proc, lk, myproc()->prio);
     sleep(lk, &lk->lk);
+    slept = 1;
   }
   lk->locked = 1;
   lk->pid = myproc()->pid;
+  lk->proc = myproc();
+  lk->waitprio = NPRIO;
+  lk->next = myproc()->held;
+  myproc()->held = lk;
+  // count it while lk->lk keeps interrupts off.
+  lockcount(lk->cls, contended, spun, slept);
   release(&lk->lk);
 }
 
 void
 releasesleep(struct sleeplock *lk)
 {
+  struct sleeplock **pp;
+
   acquire(&lk->lk);
+  for(pp = &myproc()->held; *pp; pp = &(*pp)->next){
+    if(*pp == lk){
+      *pp = lk->next;
+      break;
+    }
+  }
   lk->locked = 0;
   lk->pid = 0;
+  lk->proc = 0;
   wakeup(lk);
   release(&lk->lk);
+  unlendprio();
 }
 
 int
@@ -6,5 +6,11 @@ struct sleeplock {
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+  struct proc *proc; // Process holding lock, for priority inheritance
+  int waitprio;      // Best priority lent by a waiter, under proc->lock
+  struct sleeplock *next; // Next on proc->held
+
+  // For lockstat():
+  struct lockclass *cls;  // its name's class, to count it under; or 0
 };
 
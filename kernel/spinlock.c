@@ -7,6 +7,84 @@
 #include "riscv.h"
 #include "proc.h"
 #include "defs.h"
+#include "lockstat.h"
+
+// contention statistics are kept per lock name rather than per
+// lock, since pipes, poll() calls and thread groups make and
+// discard locks all the time; lockstat() reports them.
+// the names, once added, never change or go away.
+struct lockclass lockclass[NLOCKCLASS];
+int nlockclass;
+struct spinlock classlock;  // zero-initialized, and not counted
+
+// each CPU counts the acquires it makes in its own array, so
+// that counting costs no atomic adds and shares no cache lines;
+// lockstat() adds the CPUs' counts up.
+struct lockcount {
+  uint64 nacquire;
+  uint64 ncontend;
+  uint64 nspin;
+  uint64 nspinwin;  // sleep locks only
+  uint64 nsleep;    // sleep locks only
+};
+
+struct {
+  struct lockcount c[NLOCKCLASS];
+} __attribute__ ((aligned (64))) lockcounts[NCPU];
+
+// Find or make the lockclass for name.
+struct lockclass*
+findclass(char *name)
+{
+  struct lockclass *c, *e;
+
+  // locks of one kind are nearly always named by the same
+  // string constant, so look for that pointer first, without
+  // classlock: nlockclass only grows, after its entry is set.
+  e = &lockclass[__atomic_load_n(&nlockclass, __ATOMIC_ACQUIRE)];
+  for(c = lockclass; c < e; c++)
+    if(c->name == name)
+      return c;
+
+  acquire(&classlock);
+  for(c = lockclass; c < &lockclass[nlockclass]; c++){
+    if(strncmp(c->name, name, LOCKNAME) == 0){
+      release(&classlock);
+      return c;
+    }
+  }
+  c = 0;
+  if(nlockclass < NLOCKCLASS){
+    c = &lockclass[nlockclass];
+    c->name = name;
+    __atomic_store_n(&nlockclass, nlockclass + 1, __ATOMIC_RELEASE);
+  }
+  release(&classlock);
+  return c;
+}
+
+// Count an acquire of a lock of class cls on this CPU, which
+// had to wait spin cycles if contended. For sleep locks, slept
+// says whether it had to sleep, or got the lock by spinning.
+// Interrupts must be off.
+void
+lockcount(struct lockclass *cls, int contended, uint64 spin, int slept)
+{
+  struct lockcount *lc;
+
+  if(cls == 0)
+    return;
+  lc = &lockcounts[cpuid()].c[cls - lockclass];
+  lc->nacquire++;
+  if(contended){
+    lc->ncontend++;
+    lc->nspin += spin;
+    if(slept > 0)
+      lc->nsleep++;
+    else if(slept == 0)
+      lc->nspinwin++;
+  }
+}
 
 void
 initlock(struct spinlock *lk, char *name)
@@ -14,23 +92,171 @@ initlock(struct spinlock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->cpu = 0;
+  lk->cls = findclass(name);
+#ifdef TICKETLOCK
+  lk->next = 0;
+  lk->owner = 0;
+#endif
+#ifdef MCSLOCK
+  lk->tail = 0;
+#endif
+}
+
+// takelock() and droplock() are the lock algorithm proper,
+// chosen at build time by make LOCK=ticket or LOCK=mcs.
+// takelock() returns 1 if it had to wait, and sets *spin to
+// how long, in time CSR cycles; only a contended acquire pays
+// to read the clock. acquire() and release() supply the fences.
+
+#if defined(TICKETLOCK)
+
+// A ticket lock: take the next number and wait until it is
+// served. Waiters get the lock in the order they arrived, but
+// they all spin on the same owner word.
+static int
+takelock(struct spinlock *lk, uint64 *spin)
+{
+  uint64 start;
+  uint t;
+
+  // amoadd.w: hand out tickets atomically.
+  t = __sync_fetch_and_add(&lk->next, 1);
+  if(__atomic_load_n(&lk->owner, __ATOMIC_RELAXED) != t){
+    start = r_time();
+    while(__atomic_load_n(&lk->owner, __ATOMIC_RELAXED) != t)
+      ;
+    *spin = r_time() - start;
+    lk->locked = 1;
+    return 1;
+  }
+  lk->locked = 1;
+  return 0;
+}
+
+static void
+droplock(struct spinlock *lk)
+{
+  // only the holder writes owner, so a plain read suffices;
+  // the store must be a single one.
+  lk->locked = 0;
+  __atomic_store_n(&lk->owner, lk->owner + 1, __ATOMIC_RELAXED);
+}
+
+#elif defined(MCSLOCK)
+
+// An MCS queue lock: each waiter appends a node of its own cpu
+// to the lock's queue and spins on that node, so waiting cpus
+// don't share a cache line, and the lock passes down the queue
+// in order.
+static int
+takelock(struct spinlock *lk, uint64 *spin)
+{
+  struct cpu *c = mycpu();
+  struct mcsnode *n, *prev;
+  uint64 start;
+
+  for(n = c->mcs; n < &c->mcs[NMCS]; n++)
+    if(n->lk == 0)
+      break;
+  if(n == &c->mcs[NMCS])
+    panic("acquire: too many locks");
+  n->lk = lk;
+  n->next = 0;
+  n->wait = 1;
+
+  // amoswap.d: join the end of the queue.
+  prev = __atomic_exchange_n(&lk->tail, n, __ATOMIC_ACQ_REL);
+  if(prev != 0){
+    start = r_time();
+    __atomic_store_n(&prev->next, n, __ATOMIC_RELEASE);
+    while(__atomic_load_n(&n->wait, __ATOMIC_ACQUIRE))
+      ;
+    *spin = r_time() - start;
+    lk->locked = 1;
+    return 1;
+  }
+  lk->locked = 1;
+  return 0;
+}
+
+static void
+droplock(struct spinlock *lk)
+{
+  struct cpu *c = mycpu();
+  struct mcsnode *n, *next, *self;
+
+  for(n = c->mcs; n < &c->mcs[NMCS]; n++)
+    if(n->lk == lk)
+      break;
+  if(n == &c->mcs[NMCS])
+    panic("release: no mcs node");
+  lk->locked = 0;
+
+  if((next = __atomic_load_n(&n->next, __ATOMIC_ACQUIRE)) == 0){
+    // no known successor: empty the queue, unless a new
+    // waiter is between its amoswap and setting n->next.
+    self = n;
+    if(__atomic_compare_exchange_n(&lk->tail, &self, 0, 0,
+                                   __ATOMIC_RELEASE, __ATOMIC_RELAXED)){
+      n->lk = 0;
+      return;
+    }
+    while((next = __atomic_load_n(&n->next, __ATOMIC_ACQUIRE)) == 0)
+      ;
+  }
+  __atomic_store_n(&next->wait, 0, __ATOMIC_RELEASE);
+  n->lk = 0;
+}
+
+#else
+
+// A test-and-set lock.
+static int
+takelock(struct spinlock *lk, uint64 *spin)
+{
+  uint64 start;
+
+  // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
+  //   a5 = 1
+  //   s1 = &lk->locked
+  //   amoswap.w.aq a5, a5, (s1)
+  if(__sync_lock_test_and_set(&lk->locked, 1) == 0)
+    return 0;
+  start = r_time();
+  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
+    ;
+  *spin = r_time() - start;
+  return 1;
 }
 
+static void
+droplock(struct spinlock *lk)
+{
+  // Release the lock, equivalent to lk->locked = 0.
+  // This code doesn't use a C assignment, since the C standard
+  // implies that an assignment might be implemented with
+  // multiple store instructions.
+  // On RISC-V, sync_lock_release turns into an atomic swap:
+  //   s1 = &lk->locked
+  //   amoswap.w zero, zero, (s1)
+  __sync_lock_release(&lk->locked);
+}
+
+#endif
+
 // Acquire the lock.
 // Loops (spins) until the lock is acquired.
 void
 acquire(struct spinlock *lk)
 {
+  uint64 spin = 0;
+  int contended;
+
   push_off(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
-  // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
-  //   a5 = 1
-  //   s1 = &lk->locked
-  //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+  contended = takelock(lk, &spin);
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,6 +266,8 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for holding() and debugging.
   lk->cpu = mycpu();
+
+  lockcount(lk->cls, contended, spin, -1);
 }
 
 // Release the lock.
@@ -59,14 +287,7 @@ release(struct spinlock *lk)
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code doesn't use a C assignment, since the C standard
-  // implies that an assignment might be implemented with
-  // multiple store instructions.
-  // On RISC-V, sync_lock_release turns into an atomic swap:
-  //   s1 = &lk->locked
-  //   amoswap.w zero, zero, (s1)
-  __sync_lock_release(&lk->locked);
+  droplock(lk);
 
   pop_off();
 }
@@ -108,3 +329,38 @@ pop_off(void)
   if(c->noff == 0 && c->intena)
     intr_on();
 }
+
+// Copy the statistics for up to n lock names to user address
+// addr, an array of struct lockstat, then zero them if reset.
+// Returns the number of lock names copied, or -1.
+int
+lockstat(uint64 addr, int n, int reset)
+{
+  struct lockstat ls;
+  struct lockcount *lc;
+  int i, id, nclass, copied = 0;
+
+  nclass = __atomic_load_n(&nlockclass, __ATOMIC_ACQUIRE);
+  for(i = 0; i < nclass; i++){
+    memset(&ls, 0, sizeof(ls));
+    safestrcpy(ls.name, lockclass[i].name, sizeof(ls.name));
+    // other CPUs go on counting while we add up or zero
+    // their counts, so the sums are only approximate.
+    for(id = 0; id < NCPU; id++){
+      lc = &lockcounts[id].c[i];
+      ls.nacquire += lc->nacquire;
+      ls.ncontend += lc->ncontend;
+      ls.nspin += lc->nspin;
+      ls.nspinwin += lc->nspinwin;
+      ls.nsleep += lc->nsleep;
+      if(reset)
+        memset(lc, 0, sizeof(*lc));
+    }
+    if(i < n && addr != 0){
+      if(copyout(myproc()->pagetable, addr + i*sizeof(ls), (char*)&ls, sizeof(ls)) < 0)
+        return -1;
+      copied++;
+    }
+  }
+  return copied;
+}
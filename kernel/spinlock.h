@@ -1,9 +1,36 @@
+#ifdef MCSLOCK
+// A waiter in an MCS lock's queue. Each waiter spins on its
+// own node, and release() hands the lock to the next node.
+// Each cpu has a few, one per spinlock it holds or wants.
+struct mcsnode {
+  struct mcsnode *next;
+  int wait;                 // spin until the previous holder clears this
+  struct spinlock *lk;      // the lock this node is for, or 0 if free
+};
+#endif
+
+// The locks with one name, whose contention statistics
+// lockstat() reports together.
+struct lockclass {
+  char *name;
+};
+
 // Mutual exclusion lock.
 struct spinlock {
   uint locked;       // Is the lock held?
+#ifdef TICKETLOCK
+  uint next;         // next ticket to hand out
+  uint owner;        // ticket being served
+#endif
+#ifdef MCSLOCK
+  struct mcsnode *tail;  // last waiter in the queue, or 0
+#endif
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+
+  // For lockstat():
+  struct lockclass *cls;  // its name's class, to count it under; or 0
 };
 
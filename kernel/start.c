@@ -11,7 +11,7 @@ void timerinit();
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 
 // a scratch area per CPU for machine-mode timer interrupts.
-uint64 timer_scratch[NCPU][5];
+uint64 timer_scratch[NCPU][7];
 
 // assembly code in kernelvec.S for machine-mode timer interrupt.
 extern void timervec();
@@ -43,6 +43,13 @@ start()
   w_pmpaddr0(0x3fffffffffffffull);
   w_pmpcfg0(0xf);
 
+  // let supervisor and user mode read the time CSR, for
+  // the user clock helpers that use the VDSO page. only
+  // the kernel reads cycle and instret: it counts them
+  // per process, for perfstat().
+  w_mcounteren(r_mcounteren() | COUNTEREN_TM | COUNTEREN_CY | COUNTEREN_IR);
+  w_scounteren(r_scounteren() | COUNTEREN_TM);
+
   // ask for clock interrupts.
   timerinit();
 
@@ -57,7 +64,8 @@ start()
 // set up to receive timer interrupts in machine mode,
 // which arrive at timervec in kernelvec.S,
 // which turns them into software interrupts for
-// devintr() in trap.c.
+// devintr() in trap.c. timervec does the same for
+// interprocessor interrupts.
 void
 timerinit()
 {
@@ -72,9 +80,13 @@ timerinit()
   // scratch[0..2] : space for timervec to save registers.
   // scratch[3] : address of CLINT MTIMECMP register.
   // scratch[4] : desired interval (in cycles) between timer interrupts.
+  // scratch[5] : set when the timer fires, cleared by devintr().
+  // scratch[6] : address of CLINT MSIP register, for ipi().
   uint64 *scratch = &timer_scratch[id][0];
   scratch[3] = CLINT_MTIMECMP(id);
   scratch[4] = interval;
+  scratch[5] = 0;
+  scratch[6] = CLINT_MSIP(id);
   w_mscratch((uint64)scratch);
 
   // set the machine-mode trap handler.
@@ -83,6 +95,7 @@ timerinit()
   // enable machine-mode interrupts.
   w_mstatus(r_mstatus() | MSTATUS_MIE);
 
-  // enable machine-mode timer interrupts.
-  w_mie(r_mie() | MIE_MTIE);
+  // enable machine-mode timer and software interrupts;
+  // the latter are interprocessor interrupts from ipi().
+  w_mie(r_mie() | MIE_MTIE | MIE_MSIE);
 }
@@ -6,13 +6,15 @@
 #include "proc.h"
 #include "syscall.h"
 #include "defs.h"
+#include "trace.h"
+#include "sysstat.h"
 
 // Fetch the uint64 at addr from the current process.
 int
 fetchaddr(uint64 addr, uint64 *ip)
 {
   struct proc *p = myproc();
-  if(addr >= p->sz || addr+sizeof(uint64) > p->sz)
+  if(addr >= p->tg->sz || addr+sizeof(uint64) > p->tg->sz)
     return -1;
   if(copyin(p->pagetable, (char *)ip, addr, sizeof(*ip)) != 0)
     return -1;
@@ -104,6 +106,28 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_wait(void);
 extern uint64 sys_write(void);
 extern uint64 sys_uptime(void);
+extern uint64 sys_setpriority(void);
+extern uint64 sys_getpriority(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_join(void);
+extern uint64 sys_futex_wait(void);
+extern uint64 sys_futex_wake(void);
+extern uint64 sys_spawn(void);
+extern uint64 sys_nanosleep(void);
+extern uint64 sys_clock_gettime(void);
+extern uint64 sys_ring_setup(void);
+extern uint64 sys_ring_enter(void);
+extern uint64 sys_poll(void);
+extern uint64 sys_fcntl(void);
+extern uint64 sys_splice(void);
+extern uint64 sys_tee(void);
+extern uint64 sys_copy_file_range(void);
+extern uint64 sys_lockstat(void);
+extern uint64 sys_prof(void);
+extern uint64 sys_perfstat(void);
+extern uint64 sys_trace(void);
+extern uint64 sys_sysstat(void);
+extern uint64 sys_procstat(void);
 
 static uint64 (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -127,8 +151,105 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_setpriority] sys_setpriority,
+[SYS_getpriority] sys_getpriority,
+[SYS_clone]   sys_clone,
+[SYS_join]    sys_join,
+[SYS_futex_wait] sys_futex_wait,
+[SYS_futex_wake] sys_futex_wake,
+[SYS_spawn]   sys_spawn,
+[SYS_nanosleep] sys_nanosleep,
+[SYS_clock_gettime] sys_clock_gettime,
+[SYS_ring_setup] sys_ring_setup,
+[SYS_ring_enter] sys_ring_enter,
+[SYS_poll]    sys_poll,
+[SYS_fcntl]   sys_fcntl,
+[SYS_splice]  sys_splice,
+[SYS_tee]     sys_tee,
+[SYS_copy_file_range] sys_copy_file_range,
+[SYS_lockstat] sys_lockstat,
+[SYS_prof]    sys_prof,
+[SYS_perfstat] sys_perfstat,
+[SYS_trace]   sys_trace,
+[SYS_sysstat] sys_sysstat,
+[SYS_procstat] sys_procstat,
 };
 
+static char *sysnames[] = {
+[SYS_fork] "fork",
+[SYS_exit] "exit",
+[SYS_wait] "wait",
+[SYS_pipe] "pipe",
+[SYS_read] "read",
+[SYS_kill] "kill",
+[SYS_exec] "exec",
+[SYS_fstat] "fstat",
+[SYS_chdir] "chdir",
+[SYS_dup] "dup",
+[SYS_getpid] "getpid",
+[SYS_sbrk] "sbrk",
+[SYS_sleep] "sleep",
+[SYS_uptime] "uptime",
+[SYS_open] "open",
+[SYS_write] "write",
+[SYS_mknod] "mknod",
+[SYS_unlink] "unlink",
+[SYS_link] "link",
+[SYS_mkdir] "mkdir",
+[SYS_close] "close",
+[SYS_setpriority] "setpriority",
+[SYS_getpriority] "getpriority",
+[SYS_clone] "clone",
+[SYS_join] "join",
+[SYS_futex_wait] "futex_wait",
+[SYS_futex_wake] "futex_wake",
+[SYS_spawn] "spawn",
+[SYS_nanosleep] "nanosleep",
+[SYS_clock_gettime] "clock_gettime",
+[SYS_ring_setup] "ring_setup",
+[SYS_ring_enter] "ring_enter",
+[SYS_poll] "poll",
+[SYS_fcntl] "fcntl",
+[SYS_splice] "splice",
+[SYS_tee] "tee",
+[SYS_copy_file_range] "copy_file_range",
+[SYS_lockstat] "lockstat",
+[SYS_prof] "prof",
+[SYS_perfstat] "perfstat",
+[SYS_trace] "trace",
+[SYS_sysstat] "sysstat",
+[SYS_procstat] "procstat",
+};
+
+// each CPU counts the system calls that return on it, in its
+// own cache lines; sysstat() adds them up.
+struct syscount {
+  uint64 ncall;
+  uint64 time;
+  uint64 hist[NSYSHIST];
+};
+
+struct {
+  struct syscount c[NELEM(syscalls)];
+} __attribute__ ((aligned (64))) syscounts[NCPU];
+
+static void
+syscount(int num, uint64 t)
+{
+  struct syscount *c;
+  uint64 x;
+  int b;
+
+  for(b = 0, x = t; x > 1 && b < NSYSHIST-1; b++)
+    x >>= 1;
+  push_off();
+  c = &syscounts[cpuid()].c[num];
+  c->ncall++;
+  c->time += t;
+  c->hist[b]++;
+  pop_off();
+}
+
 void
 syscall(void)
 {
@@ -137,10 +258,49 @@ syscall(void)
 
   num = p->trapframe->a7;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
+    uint64 start = r_time();
+    TRACE(TR_SYSENTER, num, p->trapframe->a0);
     p->trapframe->a0 = syscalls[num]();
+    TRACE(TR_SYSEXIT, num, p->trapframe->a0);
+    syscount(num, r_time() - start);
   } else {
     printf("%d %s: unknown sys call %d\n",
             p->pid, p->name, num);
     p->trapframe->a0 = -1;
   }
 }
+
+// Copy the counts of up to n system calls, summed over the
+// CPUs, to addr, an array of struct sysstat, then zero them
+// if reset. Entry i is system call i+1. A call that returns
+// during a reset may be counted or not.
+// Returns the number of entries copied, or -1.
+int
+sysstat(uint64 addr, int n, int reset)
+{
+  struct sysstat ss;
+  struct syscount *c;
+  int num, i, b, copied = 0;
+
+  for(num = 1; num < NELEM(syscalls); num++){
+    if(num-1 < n && addr != 0){
+      memset(&ss, 0, sizeof(ss));
+      if(sysnames[num])
+        safestrcpy(ss.name, sysnames[num], sizeof(ss.name));
+      for(i = 0; i < NCPU; i++){
+        c = &syscounts[i].c[num];
+        ss.ncall += c->ncall;
+        ss.time += c->time;
+        for(b = 0; b < NSYSHIST; b++)
+          ss.hist[b] += c->hist[b];
+      }
+      if(copyout(myproc()->pagetable, addr + (num-1)*sizeof(ss), (char*)&ss, sizeof(ss)) < 0)
+        return -1;
+      copied++;
+    }
+    if(reset)
+      for(i = 0; i < NCPU; i++)
+        memset(&syscounts[i].c[num], 0, sizeof(struct syscount));
+  }
+  return copied;
+}
@@ -20,3 +20,25 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_setpriority 22
+#define SYS_getpriority 23
+#define SYS_clone  24
+#define SYS_join   25
+#define SYS_futex_wait 26
+#define SYS_futex_wake 27
+#define SYS_spawn  28
+#define SYS_nanosleep 29
+#define SYS_clock_gettime 30
+#define SYS_ring_setup 31
+#define SYS_ring_enter 32
+#define SYS_poll   33
+#define SYS_fcntl  34
+#define SYS_splice 35
+#define SYS_tee    36
+#define SYS_copy_file_range 37
+#define SYS_lockstat 38
+#define SYS_prof   39
+#define SYS_perfstat 40
+#define SYS_trace  41
+#define SYS_sysstat 42
+#define SYS_procstat 43
@@ -18,20 +18,28 @@
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
+// Takes a reference to the file, which the caller must fileclose(),
+// so that another thread's close(fd) cannot free it from under us.
 static int
 argfd(int n, int *pfd, struct file **pf)
 {
   int fd;
-  struct file *f;
+  struct file *f = 0;
+  struct tgroup *tg = myproc()->tg;
 
   if(argint(n, &fd) < 0)
     return -1;
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if(fd < 0 || fd >= NOFILE)
+    return -1;
+  acquire(&tg->lock);
+  if(tg->ofile[fd])
+    f = filedup(tg->ofile[fd]);
+  release(&tg->lock);
+  if(f == 0)
     return -1;
   if(pfd)
     *pfd = fd;
-  if(pf)
-    *pf = f;
+  *pf = f;
   return 0;
 }
 
@@ -41,14 +49,17 @@ static int
 fdalloc(struct file *f)
 {
   int fd;
-  struct proc *p = myproc();
+  struct tgroup *tg = myproc()->tg;
 
+  acquire(&tg->lock);
   for(fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd] == 0){
-      p->ofile[fd] = f;
+    if(tg->ofile[fd] == 0){
+      tg->ofile[fd] = f;
+      release(&tg->lock);
       return fd;
     }
   }
+  release(&tg->lock);
   return -1;
 }
 
@@ -60,9 +71,11 @@ sys_dup(void)
 
   if(argfd(0, 0, &f) < 0)
     return -1;
-  if((fd=fdalloc(f)) < 0)
+  // the new descriptor takes over argfd()'s reference.
+  if((fd=fdalloc(f)) < 0){
+    fileclose(f);
     return -1;
-  filedup(f);
+  }
   return fd;
 }
 
@@ -70,25 +83,28 @@ uint64
 sys_read(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || argfd(0, 0, &f) < 0)
     return -1;
-  return fileread(f, p, n);
+  r = fileread(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 uint64
 sys_write(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || argfd(0, 0, &f) < 0)
     return -1;
-
-  return filewrite(f, p, n);
+  r = filewrite(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 uint64
@@ -99,8 +115,18 @@ sys_close(void)
 
   if(argfd(0, &fd, &f) < 0)
     return -1;
-  myproc()->ofile[fd] = 0;
-  fileclose(f);
+  struct tgroup *tg = myproc()->tg;
+  acquire(&tg->lock);
+  if(tg->ofile[fd] != f){
+    // another thread closed it first.
+    release(&tg->lock);
+    fileclose(f);
+    return -1;
+  }
+  tg->ofile[fd] = 0;
+  release(&tg->lock);
+  fileclose(f);   // argfd()'s reference
+  fileclose(f);   // the descriptor's
   return 0;
 }
 
@@ -109,10 +135,13 @@ sys_fstat(void)
 {
   struct file *f;
   uint64 st; // user pointer to struct stat
+  int r;
 
-  if(argfd(0, 0, &f) < 0 || argaddr(1, &st) < 0)
+  if(argaddr(1, &st) < 0 || argfd(0, 0, &f) < 0)
     return -1;
-  return filestat(f, st);
+  r = filestat(f, st);
+  fileclose(f);
+  return r;
 }
 
 // Create the path new as a link to the same inode as old.
@@ -391,8 +420,8 @@ uint64
 sys_chdir(void)
 {
   char path[MAXPATH];
-  struct inode *ip;
-  struct proc *p = myproc();
+  struct inode *ip, *old;
+  struct tgroup *tg = myproc()->tg;
   
   begin_op();
   if(argstr(0, path, MAXPATH) < 0 || (ip = namei(path)) == 0){
@@ -406,52 +435,192 @@ sys_chdir(void)
     return -1;
   }
   iunlock(ip);
-  iput(p->cwd);
+  acquire(&tg->lock);
+  old = tg->cwd;
+  tg->cwd = ip;
+  release(&tg->lock);
+  iput(old);
   end_op();
-  p->cwd = ip;
   return 0;
 }
 
-uint64
-sys_exec(void)
+// Copy the user argv array at uargv, and its strings,
+// into argv[MAXARG]. Each string gets a page from kalloc(),
+// which freeargv() frees, whether or not this succeeds.
+static int
+fetchargv(uint64 uargv, char **argv)
 {
-  char path[MAXPATH], *argv[MAXARG];
   int i;
-  uint64 uargv, uarg;
+  uint64 uarg;
 
-  if(argstr(0, path, MAXPATH) < 0 || argaddr(1, &uargv) < 0){
-    return -1;
-  }
-  memset(argv, 0, sizeof(argv));
+  memset(argv, 0, MAXARG*sizeof(char*));
   for(i=0;; i++){
-    if(i >= NELEM(argv)){
-      goto bad;
+    if(i >= MAXARG){
+      return -1;
     }
     if(fetchaddr(uargv+sizeof(uint64)*i, (uint64*)&uarg) < 0){
-      goto bad;
+      return -1;
     }
     if(uarg == 0){
       argv[i] = 0;
-      break;
+      return 0;
     }
     argv[i] = kalloc();
     if(argv[i] == 0)
-      goto bad;
+      return -1;
     if(fetchstr(uarg, argv[i], PGSIZE) < 0)
-      goto bad;
+      return -1;
   }
+}
 
-  int ret = exec(path, argv);
-
-  for(i = 0; i < NELEM(argv) && argv[i] != 0; i++)
+static void
+freeargv(char **argv)
+{
+  for(int i = 0; i < MAXARG && argv[i] != 0; i++)
     kfree(argv[i]);
+}
 
+uint64
+sys_exec(void)
+{
+  char path[MAXPATH], *argv[MAXARG];
+  uint64 uargv;
+  int ret = -1;
+
+  if(argstr(0, path, MAXPATH) < 0 || argaddr(1, &uargv) < 0){
+    return -1;
+  }
+  if(fetchargv(uargv, argv) == 0)
+    ret = exec(path, argv);
+  freeargv(argv);
   return ret;
+}
 
- bad:
-  for(i = 0; i < NELEM(argv) && argv[i] != 0; i++)
-    kfree(argv[i]);
-  return -1;
+_Static_assert(NOFILE * sizeof(int) <= PGSIZE, "spawn: fds do not fit in a page");
+
+uint64
+sys_spawn(void)
+{
+  char path[MAXPATH], *argv[MAXARG];
+  int *fds = 0, nfds;
+  uint64 uargv, ufds;
+  int ret = -1;
+
+  if(argstr(0, path, MAXPATH) < 0 || argaddr(1, &uargv) < 0 ||
+     argaddr(2, &ufds) < 0 || argint(3, &nfds) < 0)
+    return -1;
+  if(nfds < 0 || nfds > NOFILE)
+    return -1;
+  // NOFILE ints are too many for the kernel stack.
+  if(nfds > 0){
+    if((fds = kalloc()) == 0)
+      return -1;
+    if(copyin(myproc()->pagetable, (char*)fds, ufds, nfds*sizeof(int)) < 0){
+      kfree(fds);
+      return -1;
+    }
+  }
+  if(fetchargv(uargv, argv) == 0)
+    ret = spawn(path, argv, fds, nfds);
+  freeargv(argv);
+  if(fds)
+    kfree(fds);
+  return ret;
+}
+
+uint64
+sys_fcntl(void)
+{
+  struct file *f;
+  int cmd, arg, r;
+
+  if(argint(1, &cmd) < 0 || argint(2, &arg) < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+  r = filefcntl(f, cmd, arg);
+  fileclose(f);
+  return r;
+}
+
+uint64
+sys_splice(void)
+{
+  struct file *in, *out;
+  int n, r;
+
+  if(argint(2, &n) < 0 || argfd(0, 0, &in) < 0)
+    return -1;
+  if(argfd(1, 0, &out) < 0){
+    fileclose(in);
+    return -1;
+  }
+  r = filesplice(in, out, n, 0);
+  fileclose(in);
+  fileclose(out);
+  return r;
+}
+
+uint64
+sys_tee(void)
+{
+  struct file *in, *out;
+  int n, r;
+
+  if(argint(2, &n) < 0 || argfd(0, 0, &in) < 0)
+    return -1;
+  if(argfd(1, 0, &out) < 0){
+    fileclose(in);
+    return -1;
+  }
+  r = filesplice(in, out, n, 1);
+  fileclose(in);
+  fileclose(out);
+  return r;
+}
+
+uint64
+sys_copy_file_range(void)
+{
+  struct file *in, *out;
+  int n, r;
+
+  if(argint(2, &n) < 0 || argfd(0, 0, &in) < 0)
+    return -1;
+  if(argfd(1, 0, &out) < 0){
+    fileclose(in);
+    return -1;
+  }
+  r = filecopy(in, out, n);
+  fileclose(in);
+  fileclose(out);
+  return r;
+}
+
+uint64
+sys_poll(void)
+{
+  uint64 fds;
+  int nfds, timeout;
+
+  if(argaddr(0, &fds) < 0 || argint(1, &nfds) < 0 || argint(2, &timeout) < 0)
+    return -1;
+  return poll(fds, nfds, timeout);
+}
+
+uint64
+sys_ring_setup(void)
+{
+  uint64 r;
+  int flags;
+
+  if(argaddr(0, &r) < 0 || argint(1, &flags) < 0)
+    return -1;
+  return ringsetup(r, flags);
+}
+
+uint64
+sys_ring_enter(void)
+{
+  return ringenter();
 }
 
 uint64
@@ -466,20 +635,26 @@ sys_pipe(void)
     return -1;
   if(pipealloc(&rf, &wf) < 0)
     return -1;
-  fd0 = -1;
-  if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
-    if(fd0 >= 0)
-      p->ofile[fd0] = 0;
-    fileclose(rf);
-    fileclose(wf);
-    return -1;
-  }
-  if(copyout(p->pagetable, fdarray, (char*)&fd0, sizeof(fd0)) < 0 ||
+  fd0 = fd1 = -1;
+  if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0 ||
+     copyout(p->pagetable, fdarray, (char*)&fd0, sizeof(fd0)) < 0 ||
      copyout(p->pagetable, fdarray+sizeof(fd0), (char *)&fd1, sizeof(fd1)) < 0){
-    p->ofile[fd0] = 0;
-    p->ofile[fd1] = 0;
-    fileclose(rf);
-    fileclose(wf);
+    // another thread may have closed the descriptors already,
+    // and even reused them: take back only what is still ours.
+    acquire(&p->tg->lock);
+    if(fd0 >= 0 && p->tg->ofile[fd0] == rf)
+      p->tg->ofile[fd0] = 0;
+    else if(fd0 >= 0)
+      rf = 0;
+    if(fd1 >= 0 && p->tg->ofile[fd1] == wf)
+      p->tg->ofile[fd1] = 0;
+    else if(fd1 >= 0)
+      wf = 0;
+    release(&p->tg->lock);
+    if(rf)
+      fileclose(rf);
+    if(wf)
+      fileclose(wf);
     return -1;
   }
   return 0;
@@ -29,6 +29,48 @@ sys_fork(void)
   return fork();
 }
 
+uint64
+sys_clone(void)
+{
+  uint64 fn, arg, stack;
+
+  if(argaddr(0, &fn) < 0 || argaddr(1, &arg) < 0 || argaddr(2, &stack) < 0)
+    return -1;
+  return clone(fn, arg, stack);
+}
+
+uint64
+sys_join(void)
+{
+  int tid;
+
+  if(argint(0, &tid) < 0)
+    return -1;
+  return join(tid);
+}
+
+uint64
+sys_futex_wait(void)
+{
+  uint64 uaddr;
+  int val;
+
+  if(argaddr(0, &uaddr) < 0 || argint(1, &val) < 0)
+    return -1;
+  return futexwait(uaddr, val);
+}
+
+uint64
+sys_futex_wake(void)
+{
+  uint64 uaddr;
+  int n;
+
+  if(argaddr(0, &uaddr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return futexwake(uaddr, n);
+}
+
 uint64
 sys_wait(void)
 {
@@ -41,15 +83,11 @@ sys_wait(void)
 uint64
 sys_sbrk(void)
 {
-  int addr;
   int n;
 
   if(argint(0, &n) < 0)
     return -1;
-  addr = myproc()->sz;
-  if(growproc(n) < 0)
-    return -1;
-  return addr;
+  return growproc(n);
 }
 
 uint64
@@ -73,6 +111,42 @@ sys_sleep(void)
   return 0;
 }
 
+// sleep for the time in the struct timespec at
+// argument 0, to the resolution of the CLINT timer.
+uint64
+sys_nanosleep(void)
+{
+  uint64 addr;
+  struct timespec ts;
+
+  if(argaddr(0, &addr) < 0)
+    return -1;
+  if(copyin(myproc()->pagetable, (char *)&ts, addr, sizeof(ts)) < 0)
+    return -1;
+  if((long)ts.sec < 0 || ts.nsec >= 1000000000)
+    return -1;
+  // round up to whole timer cycles; a sleep too long to
+  // count in them lasts as long as timersleep() can.
+  if(ts.sec >= MTIME_NEVER / MTIME_HZ)
+    return timersleep(MTIME_NEVER);
+  return timersleep(ts.sec * MTIME_HZ + (ts.nsec + NSPERCYCLE - 1) / NSPERCYCLE);
+}
+
+// store the time since boot in the struct timespec
+// at argument 0.
+uint64
+sys_clock_gettime(void)
+{
+  uint64 addr, now = timenow();
+  struct timespec ts;
+
+  if(argaddr(0, &addr) < 0)
+    return -1;
+  ts.sec = now / MTIME_HZ;
+  ts.nsec = (now % MTIME_HZ) * NSPERCYCLE;
+  return copyout(myproc()->pagetable, addr, (char *)&ts, sizeof(ts));
+}
+
 uint64
 sys_kill(void)
 {
@@ -95,3 +169,89 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+uint64
+sys_setpriority(void)
+{
+  int pid, nice;
+
+  if(argint(0, &pid) < 0 || argint(1, &nice) < 0)
+    return -1;
+  return setpriority(pid, nice);
+}
+
+uint64
+sys_getpriority(void)
+{
+  int pid;
+
+  if(argint(0, &pid) < 0)
+    return -1;
+  return getpriority(pid);
+}
+
+uint64
+sys_lockstat(void)
+{
+  uint64 addr;
+  int n, reset;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0 || argint(2, &reset) < 0)
+    return -1;
+  return lockstat(addr, n, reset);
+}
+
+uint64
+sys_prof(void)
+{
+  uint64 addr;
+  int cmd, n;
+
+  if(argint(0, &cmd) < 0 || argaddr(1, &addr) < 0 || argint(2, &n) < 0)
+    return -1;
+  return prof(cmd, addr, n);
+}
+
+uint64
+sys_perfstat(void)
+{
+  uint64 addr;
+  int who;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &who) < 0)
+    return -1;
+  return perfstat(addr, who);
+}
+
+uint64
+sys_trace(void)
+{
+  uint64 addr;
+  int cmd, n;
+
+  if(argint(0, &cmd) < 0 || argaddr(1, &addr) < 0 || argint(2, &n) < 0)
+    return -1;
+  return trace(cmd, addr, n);
+}
+
+uint64
+sys_sysstat(void)
+{
+  uint64 addr;
+  int n, reset;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0 || argint(2, &reset) < 0)
+    return -1;
+  return sysstat(addr, n, reset);
+}
+
+uint64
+sys_procstat(void)
+{
+  uint64 addr;
+  int n;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return procstat(addr, n);
+}
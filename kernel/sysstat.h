@@ -0,0 +1,13 @@
+// System call counts and latencies, per system call, as
+// copied out by the sysstat() system call.
+
+#define NSYSHIST 24
+
+struct sysstat {
+  char name[16];
+  uint64 ncall;           // calls that returned
+  uint64 time;            // time CSR cycles spent in them
+  uint64 hist[NSYSHIST];  // calls that took [2^i, 2^(i+1)) cycles;
+                          // 0 cycles counts in hist[0], the
+                          // slowest in hist[NSYSHIST-1]
+};
@@ -0,0 +1,253 @@
+//
+// high-resolution timers.
+//
+// each CPU keeps a min-heap of pending timer deadlines,
+// and programs its CLINT mtimecmp for the earlier of the
+// first deadline and its next scheduling tick. timervec
+// only turns the timer off and raises a software interrupt;
+// timerintr() then fires expired timers and re-programs.
+// a CPU that is idle has no tick, but still fires timers.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "timer.h"
+
+// each CPU's scratch area for timervec, from start.c;
+// scratch[4] is the tick interval.
+extern uint64 timer_scratch[NCPU][7];
+
+#define NOTIME (~0UL)
+
+struct timerq {
+  struct spinlock lock;
+  uint64 nexttick;             // mtime of the next tick, or NOTIME
+  int n;
+  struct timer *heap[NPROC];   // heap[0] has the earliest deadline
+} __attribute__ ((aligned (64))) timerq[NCPU];
+
+void
+timerqinit(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    initlock(&timerq[i].lock, "timerq");
+}
+
+uint64
+timenow(void)
+{
+  return *(uint64*)CLINT_MTIME;
+}
+
+static void
+heapswap(struct timerq *tq, int i, int j)
+{
+  struct timer *t = tq->heap[i];
+
+  tq->heap[i] = tq->heap[j];
+  tq->heap[j] = t;
+  tq->heap[i]->i = i;
+  tq->heap[j]->i = j;
+}
+
+// move heap[i] to its place, up or down.
+static void
+heapfix(struct timerq *tq, int i)
+{
+  while(i > 0 && tq->heap[i]->when < tq->heap[(i-1)/2]->when){
+    heapswap(tq, i, (i-1)/2);
+    i = (i-1)/2;
+  }
+  for(;;){
+    int m = i, l = 2*i+1, r = 2*i+2;
+    if(l < tq->n && tq->heap[l]->when < tq->heap[m]->when)
+      m = l;
+    if(r < tq->n && tq->heap[r]->when < tq->heap[m]->when)
+      m = r;
+    if(m == i)
+      break;
+    heapswap(tq, i, m);
+    i = m;
+  }
+}
+
+// take t off its heap. tq->lock must be held.
+static void
+heapremove(struct timerq *tq, struct timer *t)
+{
+  int i = t->i;
+
+  tq->n--;
+  if(i != tq->n){
+    tq->heap[i] = tq->heap[tq->n];
+    tq->heap[i]->i = i;
+    heapfix(tq, i);
+  }
+  t->i = -1;
+}
+
+// set tq's CPU's mtimecmp for its next tick or deadline.
+// tq->lock must be held.
+static void
+timerprogram(struct timerq *tq)
+{
+  uint64 when = tq->nexttick;
+
+  if(tq->n > 0 && tq->heap[0]->when < when)
+    when = tq->heap[0]->when;
+  *(uint64*)CLINT_MTIMECMP(tq - timerq) = when;
+}
+
+// Handle a timer interrupt on this CPU: wake the sleepers
+// whose deadlines have passed, and program the next interrupt.
+// Returns 1 if it is time for a scheduling tick.
+int
+timerintr(void)
+{
+  int id = cpuid();
+  struct timerq *tq = &timerq[id];
+  uint64 interval = timer_scratch[id][4];
+  uint64 now = timenow();
+  int tick = 0;
+
+  acquire(&tq->lock);
+  while(tq->n > 0 && tq->heap[0]->when <= now){
+    struct timer *t = tq->heap[0];
+    heapremove(tq, t);
+    // holding tq->lock keeps t alive until timerdel().
+    if(t->lk){
+      acquire(t->lk);
+      t->fired = 1;
+      wakeup(t->chan);
+      release(t->lk);
+    } else {
+      wakeup(t->chan);
+    }
+  }
+  // nexttick is 0 until the first tick, which timerinit() set up.
+  if(tq->nexttick != NOTIME && tq->nexttick <= now){
+    tick = 1;
+    tq->nexttick += interval;
+    if(tq->nexttick <= now)
+      tq->nexttick = now + interval;
+  }
+  timerprogram(tq);
+  release(&tq->lock);
+  return tick;
+}
+
+// Stop this CPU's scheduling ticks, while it is idle.
+// Its timers still fire.
+void
+timerstop(void)
+{
+  struct timerq *tq;
+
+  push_off();
+  tq = &timerq[cpuid()];
+  acquire(&tq->lock);
+  tq->nexttick = NOTIME;
+  timerprogram(tq);
+  release(&tq->lock);
+  pop_off();
+}
+
+// Restart this CPU's scheduling ticks, one interval from now.
+void
+timerstart(void)
+{
+  struct timerq *tq;
+
+  push_off();
+  int id = cpuid();
+  tq = &timerq[id];
+  acquire(&tq->lock);
+  tq->nexttick = timenow() + timer_scratch[id][4];
+  timerprogram(tq);
+  release(&tq->lock);
+  pop_off();
+}
+
+// add t to this CPU's heap. tq->lock must be held.
+static void
+heapadd(struct timerq *tq, struct timer *t)
+{
+  t->cpu = tq - timerq;
+  t->i = tq->n++;
+  tq->heap[t->i] = t;
+  heapfix(tq, t->i);
+  if(t->i == 0)
+    timerprogram(tq);
+}
+
+// Start t, whose when, chan and lk the caller has set.
+// When it fires, it does wakeup(t->chan), holding t->lk
+// if that is not 0, and sets t->fired, which a holder of
+// t->lk can check before it sleeps on t->chan.
+// The caller must not hold t->lk.
+void
+timeradd(struct timer *t)
+{
+  struct timerq *tq;
+
+  t->fired = 0;
+  push_off();
+  tq = &timerq[cpuid()];
+  acquire(&tq->lock);
+  pop_off();
+  heapadd(tq, t);
+  release(&tq->lock);
+}
+
+// Cancel t if it has not fired. Once this returns, the
+// timer code is done with t, which the caller may free.
+// The caller must not hold t->lk.
+void
+timerdel(struct timer *t)
+{
+  struct timerq *tq = &timerq[t->cpu];
+
+  acquire(&tq->lock);
+  if(t->i >= 0)
+    heapremove(tq, t);
+  release(&tq->lock);
+}
+
+// Sleep for the given number of CLINT mtime cycles.
+// Return 0, or -1 if killed.
+int
+timersleep(uint64 cycles)
+{
+  struct proc *p = myproc();
+  struct timerq *tq;
+  struct timer t;
+
+  push_off();
+  tq = &timerq[cpuid()];
+  acquire(&tq->lock);
+  pop_off();
+
+  t.when = timenow();
+  t.when = cycles < MTIME_NEVER - t.when ? t.when + cycles : MTIME_NEVER;
+  t.chan = &t;
+  t.lk = 0;
+  heapadd(tq, &t);
+
+  // the sleeper may move to another CPU, but t stays
+  // on this one's heap, under this one's lock.
+  while(t.i >= 0){
+    if(p->killed){
+      heapremove(tq, &t);
+      release(&tq->lock);
+      return -1;
+    }
+    sleep(&t, &tq->lock);
+  }
+  release(&tq->lock);
+  return 0;
+}
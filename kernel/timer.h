@@ -0,0 +1,10 @@
+// a pending deadline, on the timer heap of the CPU
+// that added it (see timer.c).
+struct timer {
+  uint64 when;            // CLINT mtime at which it fires
+  void *chan;             // it fires by wakeup(chan),
+  struct spinlock *lk;    // holding lk, if not 0
+  int cpu;                // whose heap it is on
+  int i;                  // index in that heap, or -1 once fired
+  int fired;              // set, holding lk, when it fires
+};
@@ -0,0 +1,107 @@
+//
+// event tracing.
+//
+// each CPU appends to its own ring with interrupts off, so
+// adding an event takes no lock: the ring has one producer.
+// readers in trace() may run on any CPU, and claim events
+// by advancing tail with a compare-and-swap after copying
+// them. the producer does not reuse a slot until tail has
+// passed it, and drops events while its ring is full.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "trace.h"
+
+struct tracering {
+  uint head;                   // written only by this CPU
+  uint tail;                   // advanced by readers
+  uint64 dropped;
+  struct traceevent e[NTRACE];
+} __attribute__ ((aligned (64))) tracering[NCPU];
+
+int tracing;
+
+// Record an event on this CPU; use TRACE(), which skips the
+// call while tracing is off.
+void
+traceevent(int type, uint64 a0, uint64 a1)
+{
+  struct tracering *r;
+  struct traceevent *e;
+  struct proc *p;
+  uint head;
+
+  push_off();
+  r = &tracering[cpuid()];
+  head = r->head;
+  if(head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == NTRACE){
+    r->dropped++;
+    pop_off();
+    return;
+  }
+  e = &r->e[head % NTRACE];
+  e->time = r_time();
+  e->cpu = cpuid();
+  e->type = type;
+  p = mycpu()->proc;
+  e->pid = p ? p->pid : 0;
+  e->arg[0] = a0;
+  e->arg[1] = a1;
+  __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+  pop_off();
+}
+
+// The trace() system call: start or stop tracing, or copy up
+// to n events to user address addr, oldest first on each CPU.
+int
+trace(int cmd, uint64 addr, int n)
+{
+  struct tracering *r;
+  struct traceevent e;
+  uint64 dropped = 0;
+  uint t;
+  int i = 0;
+
+  switch(cmd){
+  case TRACE_START:
+    // drop the unread events. one that a CPU is adding
+    // at this moment may survive, and come out first.
+    tracing = 0;
+    __sync_synchronize();
+    for(r = tracering; r < &tracering[NCPU]; r++){
+      __atomic_store_n(&r->tail, r->head, __ATOMIC_RELEASE);
+      r->dropped = 0;
+    }
+    __sync_synchronize();
+    tracing = 1;
+    return 0;
+  case TRACE_STOP:
+    tracing = 0;
+    for(r = tracering; r < &tracering[NCPU]; r++)
+      dropped += r->dropped;
+    return dropped;
+  case TRACE_READ:
+    for(r = tracering; r < &tracering[NCPU] && i < n; r++){
+      while(i < n){
+        t = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        if(t == __atomic_load_n(&r->head, __ATOMIC_ACQUIRE))
+          break;
+        e = r->e[t % NTRACE];
+        if(!__atomic_compare_exchange_n(&r->tail, &t, t + 1, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+          continue;  // another reader took it
+        if(copyout(myproc()->pagetable, addr + i*sizeof(e), (char*)&e, sizeof(e)) < 0)
+          return -1;
+        i++;
+      }
+    }
+    return i;
+  }
+  return -1;
+}
@@ -0,0 +1,32 @@
+// Event tracing: while tracing is on, tracepoints append
+// binary events to a per-CPU ring. trace() reads them out.
+
+struct traceevent {
+  uint64 time;          // time CSR
+  ushort cpu;
+  ushort type;          // TR_*
+  int pid;              // 0 in the scheduler
+  uint64 arg[2];        // see the TR_* comments
+};
+
+// event types and their arguments
+#define TR_SYSENTER    1  // syscall number, first argument
+#define TR_SYSEXIT     2  // syscall number, return value
+#define TR_SWITCH      3  // sched() gives up the CPU: state, sleep chan
+#define TR_RUN         4  // scheduler() runs pid: priority
+#define TR_BREAD       5  // block number, 1 if it was cached
+#define TR_BWRITE      6  // block number
+#define TR_COMMIT      7  // log commit starts: blocks in the transaction
+#define TR_COMMITDONE  8  // log commit ends: same
+#define TR_DISK        9  // disk request queued: block number, 1 if a write
+#define TR_DISKDONE   10  // disk request completes: block number
+#define NTRTYPE       11
+
+// trace() commands
+#define TRACE_START 1   // discard old events and start tracing
+#define TRACE_STOP  2   // stop; returns the number of events dropped
+#define TRACE_READ  3   // take up to n events; returns how many
+
+// a tracepoint: costs one load and branch while tracing is off.
+#define TRACE(type, a0, a1) \
+  do { if(tracing) traceevent((type), (a0), (a1)); } while(0)
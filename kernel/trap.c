@@ -5,10 +5,30 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "vdso.h"
+#include "syscall.h"
 
 struct spinlock tickslock;
 uint ticks;
 
+// system calls that may take the fast path through uservec,
+// which does not save s0-s11 and t2-t6 in the trapframe:
+// all but fork() and clone(), which copy the trapframe, and
+// exec(), which sets user registers the fast path does not
+// restore. build with -DNOFASTCALL to send them all the slow way.
+#ifdef NOFASTCALL
+#define FASTMASK 0
+#else
+#define FASTMASK (~((1L << SYS_fork) | (1L << SYS_clone) | (1L << SYS_exec) | 1L))
+#endif
+
+// what usertrapfast() returns to uservec, in a0 and a1.
+struct fastret {
+  uint64 satp;   // user page table
+  uint64 flush;  // must flush the TLB after switching to it
+};
+struct fastret usertrapfast(void);
+
 extern char trampoline[], uservec[], userret[];
 
 // in kernelvec.S, calls kerneltrap().
@@ -46,6 +66,11 @@ usertrap(void)
   w_stvec((uint64)kernelvec);
 
   struct proc *p = myproc();
+
+  // the time since usertrapret() was spent in user space.
+  uint64 t = r_time() - p->umark;
+  p->perf.utime += t;
+  p->perf.stime -= t;
   
   // save user program counter.
   p->trapframe->epc = r_sepc();
@@ -77,8 +102,11 @@ usertrap(void)
     exit(-1);
 
   // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
-    yield();
+  if(which_dev == 2){
+    if(profiling)
+      profuser(p);
+    preempt();
+  }
 
   usertrapret();
 }
@@ -105,6 +133,9 @@ usertrapret(void)
   p->trapframe->kernel_sp = p->kstack + PGSIZE; // process's kernel stack
   p->trapframe->kernel_trap = (uint64)usertrap;
   p->trapframe->kernel_hartid = r_tp();         // hartid for cpuid()
+  p->trapframe->kernel_fast = (uint64)usertrapfast;
+  p->trapframe->fastmask = FASTMASK;
+  p->trapframe->kernel_flush = !asids;          // kernel ASID is not its own
 
   // set up the registers that trampoline.S's sret will use
   // to get to user space.
@@ -119,13 +150,64 @@ usertrapret(void)
   w_sepc(p->trapframe->epc);
 
   // tell trampoline.S the user page table to switch to.
-  uint64 satp = MAKE_SATP(p->pagetable);
+  uint64 satp = MAKE_SATP(p->pagetable) | SATP_ASID(p->tg->asid);
 
   // jump to trampoline.S at the top of memory, which 
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
   uint64 fn = TRAMPOLINE + (userret - trampoline);
-  ((void (*)(uint64,uint64))fn)(TRAPFRAME, satp);
+  p->umark = r_time();
+  ((void (*)(uint64,uint64,uint64))fn)(p->tfva, satp, tlbstale());
+}
+
+//
+// a system call on the fast path: uservec saved only the
+// registers a system call may not clobber, plus a0-a7, and
+// calls here on the kernel stack. the user's s0-s11 live on
+// in this function's callee-saved registers, and are back in
+// place when it returns to uservec, which returns to user
+// space. the slow path's work of setting up the trapframe
+// and sstatus for the next trap is only redone if the
+// process gave up the CPU.
+//
+struct fastret
+usertrapfast(void)
+{
+  struct proc *p = myproc();
+  struct fastret r;
+  uint64 t, nswitch;
+
+  w_stvec((uint64)kernelvec);
+
+  t = r_time() - p->umark;
+  p->perf.utime += t;
+  p->perf.stime -= t;
+
+  // return to the instruction after the ecall.
+  p->trapframe->epc = r_sepc() + 4;
+
+  if(p->killed)
+    exit(-1);
+  nswitch = p->use.nvcsw + p->use.nivcsw;
+  intr_on();
+  syscall();
+  if(p->killed)
+    exit(-1);
+
+  intr_off();
+  w_stvec(TRAMPOLINE + (uservec - trampoline));
+  if(p->use.nvcsw + p->use.nivcsw != nswitch){
+    // other code has run on this CPU since the trap, and
+    // this may not be the CPU the trap arrived on.
+    w_sstatus((r_sstatus() & ~SSTATUS_SPP) | SSTATUS_SPIE);
+    p->trapframe->kernel_hartid = r_tp();
+  }
+  w_sepc(p->trapframe->epc);
+
+  p->umark = r_time();
+  r.satp = MAKE_SATP(p->pagetable) | SATP_ASID(p->tg->asid);
+  r.flush = tlbstale();
+  return r;
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -149,22 +231,42 @@ kerneltrap()
     panic("kerneltrap");
   }
 
+  // kernelvec did not touch s0, so kerneltrap()'s frame holds
+  // the interrupted code's frame pointer, just below its own
+  // return address.
+  if(which_dev == 2 && profiling)
+    profkernel(sepc, *(uint64*)(r_fp() - 16), r_fp());
+
   // give up the CPU if this is a timer interrupt.
   if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING)
-    yield();
+    preempt();
 
-  // the yield() may have caused some traps to occur,
+  // the preempt() may have caused some traps to occur,
   // so restore trap registers for use by kernelvec.S's sepc instruction.
   w_sepc(sepc);
   w_sstatus(sstatus);
 }
 
+// each CPU's scratch area for timervec, from start.c.
+extern uint64 timer_scratch[NCPU][7];
+
+// Interrupt CPU cpu, to get it out of wfi.
+void
+ipi(int cpu)
+{
+  *(uint32*)CLINT_MSIP(cpu) = 1;
+}
+
 void
 clockintr()
 {
   acquire(&tickslock);
   ticks++;
+  vdso->ticks = ticks;
   wakeup(&ticks);
+  // leave the boost itself to the scheduler.
+  if(ticks % PRIOBOOST == 0)
+    __atomic_store_n(&boostpending, 1, __ATOMIC_RELAXED);
   release(&tickslock);
 }
 
@@ -187,8 +289,10 @@ devintr()
 
     if(irq == UART0_IRQ){
       uartintr();
+#ifndef RAMDISK
     } else if(irq == VIRTIO0_IRQ){
       virtio_disk_intr();
+#endif
     } else if(irq){
       printf("unexpected interrupt irq=%d\n", irq);
     }
@@ -201,17 +305,26 @@ devintr()
 
     return 1;
   } else if(scause == 0x8000000000000001L){
-    // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
+    // software interrupt from a machine-mode timer interrupt
+    // or interprocessor interrupt, forwarded by timervec
+    // in kernelvec.S.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
     // the SSIP bit in sip.
     w_sip(r_sip() & ~2);
 
+    // an ipi() only had to wake this CPU up, and
+    // a timer deadline that is not a tick only needs
+    // timerintr() to wake its sleeper.
+    if(__sync_lock_test_and_set(&timer_scratch[cpuid()][5], 0) == 0)
+      return 1;
+    if(timerintr() == 0)
+      return 1;
+
+    if(cpuid() == 0){
+      clockintr();
+    }
+
     return 2;
   } else {
     return 0;
@@ -0,0 +1,15 @@
+// Read-only pages mapped into every process, so that
+// user code can read the clock and its pid without a
+// system call (see the vdso_ helpers in user/ulib.c).
+
+// at VDSO, the same page in all processes.
+struct vdso {
+  uint ticks;       // a copy of ticks, for uptime()
+  uint64 hz;        // time CSR cycles per second
+};
+
+// at VDSOPROC, a page for each process.
+struct vdsoproc {
+  int pid;          // the process's pid; a thread's getpid()
+                    // is its own id from clone() instead.
+};
@@ -11,6 +11,15 @@
  */
 pagetable_t kernel_pagetable;
 
+// bumped whenever a page table mapping changes; a CPU
+// whose TLB may predate that flushes it before returning
+// to user space. see tlbstale().
+uint64 tlbgen = 1;
+
+// set if satp holds an ASID for every thread group, so that
+// trap entry and exit need not flush the TLB.
+int asids;
+
 extern char etext[];  // kernel.ld sets this to end of kernel code.
 
 extern char trampoline[]; // trampoline.S
@@ -30,6 +39,9 @@ kvmmake(void)
   // virtio mmio disk interface
   kvmmap(kpgtbl, VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W);
 
+  // CLINT, for timerstop() and ipi()
+  kvmmap(kpgtbl, CLINT, CLINT, 0x10000, PTE_R | PTE_W);
+
   // PLIC
   kvmmap(kpgtbl, PLIC, PLIC, 0x400000, PTE_R | PTE_W);
 
@@ -61,10 +73,21 @@ kvminit(void)
 void
 kvminithart()
 {
+  // the kernel's page table uses ASID 0; see whether
+  // there are enough more for the thread groups.
+  w_satp(MAKE_SATP(kernel_pagetable) | SATP_ASID(NPROC));
+  asids = (SATP_ASIDOF(r_satp()) == NPROC);
   w_satp(MAKE_SATP(kernel_pagetable));
   sfence_vma();
 }
 
+// A mapping changed.
+static void
+tlbchanged(void)
+{
+  __atomic_fetch_add(&tlbgen, 1, __ATOMIC_RELEASE);
+}
+
 // Return the address of the PTE in page table pagetable
 // that corresponds to virtual address va.  If alloc!=0,
 // create any required page-table pages.
@@ -91,6 +114,9 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
       if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
         return 0;
       memset(pagetable, 0, PGSIZE);
+      // other threads walk a shared page table without its
+      // tgroup's lock: they must see the zeroed page first.
+      __sync_synchronize();
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
@@ -146,16 +172,20 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
   a = PGROUNDDOWN(va);
   last = PGROUNDDOWN(va + size - 1);
   for(;;){
-    if((pte = walk(pagetable, a, 1)) == 0)
+    if((pte = walk(pagetable, a, 1)) == 0){
+      tlbchanged();
       return -1;
+    }
     if(*pte & PTE_V)
       panic("mappages: remap");
+    __sync_synchronize();       // the page's contents first, as in walk()
     *pte = PA2PTE(pa) | perm | PTE_V;
     if(a == last)
       break;
     a += PGSIZE;
     pa += PGSIZE;
   }
+  tlbchanged();
   return 0;
 }
 
@@ -184,6 +214,7 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
     }
     *pte = 0;
   }
+  tlbchanged();
 }
 
 // create an empty user page table.
@@ -217,28 +248,41 @@ uvminit(pagetable_t pagetable, uchar *src, uint sz)
 
 // Allocate PTEs and physical memory to grow process from oldsz to
 // newsz, which need not be page aligned.  Returns new size or 0 on error.
+// All or nothing: the page-table pages are made and the memory is
+// found before anything is mapped, so that a failure never has to
+// unmap pages that other threads may already be using. Page-table
+// pages made for a call that then fails stay, empty.
 uint64
 uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
 {
-  char *mem;
+  char *mem, *list = 0;
   uint64 a;
 
   if(newsz < oldsz)
     return oldsz;
 
   oldsz = PGROUNDUP(oldsz);
+  for(a = oldsz; a < newsz; a += PGSIZE)
+    if(walk(pagetable, a, 1) == 0)
+      return 0;
+  // keep the pages on a list, linked through their first words.
   for(a = oldsz; a < newsz; a += PGSIZE){
-    mem = kalloc();
-    if(mem == 0){
-      uvmdealloc(pagetable, a, oldsz);
+    if((mem = kalloc()) == 0){
+      while((mem = list) != 0){
+        list = *(char**)mem;
+        kfree(mem);
+      }
       return 0;
     }
+    *(char**)mem = list;
+    list = mem;
+  }
+  for(a = oldsz; a < newsz; a += PGSIZE){
+    mem = list;
+    list = *(char**)mem;
     memset(mem, 0, PGSIZE);
-    if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_W|PTE_X|PTE_R|PTE_U) != 0){
-      kfree(mem);
-      uvmdealloc(pagetable, a, oldsz);
-      return 0;
-    }
+    if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_W|PTE_X|PTE_R|PTE_U) != 0)
+      panic("uvmalloc");
   }
   return newsz;
 }
@@ -338,6 +382,7 @@ uvmclear(pagetable_t pagetable, uint64 va)
   if(pte == 0)
     panic("uvmclear");
   *pte &= ~PTE_U;
+  tlbchanged();
 }
 
 // Copy from kernel to user.
@@ -347,12 +392,17 @@ int
 copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 {
   uint64 n, va0, pa0;
+  pte_t *pte;
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
     pa0 = walkaddr(pagetable, va0);
     if(pa0 == 0)
       return -1;
+    // user code may not write the VDSO pages; neither may the kernel for it.
+    pte = walk(pagetable, va0, 0);
+    if((*pte & PTE_W) == 0)
+      return -1;
     n = PGSIZE - (dstva - va0);
     if(n > len)
       n = len;
@@ -1,4 +1,5 @@
 #include "kernel/types.h"
+#include "kernel/param.h"
 #include "kernel/fs.h"
 #include "kernel/stat.h"
 #include "user/user.h"
@@ -23,6 +24,26 @@ int hasElem(const queue *q);
 int match(char *path, char *pattern);
 
 #define BUF_SIZE 512
+
+// with -exec, the command to run on each match,
+// with room for the path and a terminating 0.
+char *execargv[MAXARG + 2];
+int execargc;
+
+// Run the -exec command on path, without forking find.
+void runexec(char *path) {
+  int stdfds[3] = {0, 1, 2};
+  int pid;
+
+  execargv[execargc] = path;
+  execargv[execargc + 1] = 0;
+  if ((pid = spawn(execargv[0], execargv, stdfds, 3)) < 0) {
+    fprintf(2, "find: exec %s failed\n", execargv[0]);
+    return;
+  }
+  while (wait(0) != pid)
+    ;
+}
 ////////////////////////////////////////////////////////////////////////////////
 void find(char *root, char *filename) {
   queue *q = initQueue();
@@ -55,8 +76,12 @@ void find(char *root, char *filename) {
       continue;
     }
 
-    if (match(path, filename))
-      printf("%s\n", path);
+    if (match(path, filename)) {
+      if (execargc > 0)
+        runexec(path);
+      else
+        printf("%s\n", path);
+    }
 
     switch (st.type) {
     case T_DEVICE:
@@ -90,6 +115,19 @@ void find(char *root, char *filename) {
   exit(0);
 }
 int main(int argc, char *argv[]) {
+  // find [dir] pattern -exec cmd [args...]
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-exec") == 0) {
+      if (i + 1 == argc || argc - (i + 1) > MAXARG) {
+        fprintf(2, "usage: find [dir] pattern [-exec cmd [args...]]\n");
+        exit(1);
+      }
+      for (execargc = 0; i + 1 + execargc < argc; execargc++)
+        execargv[execargc] = argv[i + 1 + execargc];
+      argc = i;
+      break;
+    }
+  }
   switch (argc) {
   case 2:
     find(".", argv[1]);
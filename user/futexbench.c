@@ -0,0 +1,88 @@
+// lock contention benchmark: threads increment a shared
+// counter under a futex mutex, and then under a spinlock,
+// and the time for each is compared. The waiters on a
+// contended mutex sleep, rather than burn the CPU that
+// the holder needs to finish and release the lock.
+//
+// usage: futexbench [nthreads [iters]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+int iters;
+volatile int counter;
+struct mutex mutex;
+uint spin;
+
+void
+mutexthread(void *arg)
+{
+  for(int i = 0; i < iters; i++){
+    mutex_lock(&mutex);
+    counter++;
+    mutex_unlock(&mutex);
+  }
+}
+
+void
+spinthread(void *arg)
+{
+  for(int i = 0; i < iters; i++){
+    while(__sync_lock_test_and_set(&spin, 1) != 0)
+      ;
+    __sync_synchronize();
+    counter++;
+    __sync_synchronize();
+    __sync_lock_release(&spin);
+  }
+}
+
+int
+run(char *name, void (*fn)(void*), int nthreads)
+{
+  int tids[NPROC];
+
+  counter = 0;
+  int start = uptime();
+  for(int i = 0; i < nthreads; i++){
+    if((tids[i] = thread_create(fn, 0)) < 0){
+      fprintf(2, "futexbench: thread_create failed\n");
+      exit(1);
+    }
+  }
+  for(int i = 0; i < nthreads; i++)
+    thread_join(tids[i]);
+  int t = uptime() - start;
+
+  if(counter != nthreads * iters){
+    printf("futexbench: %s: counter %d, expected %d\n",
+           name, counter, nthreads * iters);
+    exit(1);
+  }
+  printf("futexbench: %s: %d threads x %d in %d ticks\n",
+         name, nthreads, iters, t);
+  return t;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nthreads = 8;
+
+  iters = 20000;
+  if(argc > 1)
+    nthreads = atoi(argv[1]);
+  if(argc > 2)
+    iters = atoi(argv[2]);
+  if(nthreads < 1 || nthreads > NPROC-4 || iters < 1){
+    fprintf(2, "usage: futexbench [nthreads [iters]]\n");
+    exit(1);
+  }
+
+  mutex_init(&mutex);
+  run("mutex", mutexthread, nthreads);
+  run("spinlock", spinthread, nthreads);
+  exit(0);
+}
@@ -0,0 +1,115 @@
+// hammer the global kmem, bcache and log locks from several
+// processes at once, and report the time taken and how
+// contended each lock was. compare kernels built with
+// make CPUS=8, make CPUS=8 LOCK=ticket and make CPUS=8 LOCK=mcs.
+//
+// usage: lockbench [nproc [iters]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/param.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+#define FILE "lockbench.tmp"
+
+struct lockstat ls[NLOCKCLASS];
+
+// kmem: allocate and free a page.
+void
+kmem(int iters)
+{
+  for(int i = 0; i < iters; i++){
+    if(sbrk(4096) == (char*)-1){
+      fprintf(2, "lockbench: sbrk failed\n");
+      exit(1);
+    }
+    sbrk(-4096);
+  }
+}
+
+// bcache: re-read a cached block, along with the directory
+// and i-node blocks that open() looks at.
+void
+bcache(int iters)
+{
+  char buf[64];
+  int fd;
+
+  for(int i = 0; i < iters; i++){
+    if((fd = open(FILE, O_RDONLY)) < 0){
+      fprintf(2, "lockbench: open %s failed\n", FILE);
+      exit(1);
+    }
+    read(fd, buf, sizeof(buf));
+    close(fd);
+  }
+}
+
+// log: a file system call that begins and ends an operation
+// without writing anything.
+void
+logop(int iters)
+{
+  for(int i = 0; i < iters; i++)
+    unlink("lockbench.none");
+}
+
+void
+run(char *name, char *lock, void (*f)(int), int nproc, int iters)
+{
+  int i, start, t;
+  uint64 ncontend = 0, nspin = 0;
+
+  lockstat(0, 0, 1);
+  start = uptime();
+  for(i = 0; i < nproc; i++){
+    if(fork() == 0){
+      f(iters);
+      exit(0);
+    }
+  }
+  for(i = 0; i < nproc; i++)
+    wait(0);
+  t = uptime() - start;
+
+  int n = lockstat(ls, NLOCKCLASS, 0);
+  for(i = 0; i < n; i++){
+    if(strcmp(ls[i].name, lock) == 0){
+      ncontend = ls[i].ncontend;
+      nspin = ls[i].nspin;
+    }
+  }
+  printf("%s: %d ticks, %s lock contended %l times for %l cycles\n",
+         name, t, lock, ncontend, nspin);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nproc = 8, iters = 2000;
+  int fd;
+
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(argc > 2)
+    iters = atoi(argv[2]);
+  if(nproc < 1 || iters < 1){
+    fprintf(2, "usage: lockbench [nproc [iters]]\n");
+    exit(1);
+  }
+
+  if((fd = open(FILE, O_CREATE|O_WRONLY)) < 0 || write(fd, "lockbench", 9) != 9){
+    fprintf(2, "lockbench: cannot create %s\n", FILE);
+    exit(1);
+  }
+  close(fd);
+
+  run("kmem", "kmem", kmem, nproc, iters);
+  run("bcache", "bcache", bcache, nproc, iters);
+  run("log", "log", logop, nproc, iters);
+
+  unlink(FILE);
+  exit(0);
+}
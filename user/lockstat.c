@@ -0,0 +1,64 @@
+// print spinlock contention, most contended lock names first.
+//
+// usage: lockstat [command [args...]]
+//
+// with a command, zero the counts, run the command, and
+// report only the contention while it ran.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+struct lockstat ls[NLOCKCLASS];
+
+int
+main(int argc, char *argv[])
+{
+  int i, j, n;
+  struct lockstat t;
+
+  if(argc > 1){
+    lockstat(0, 0, 1);
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "lockstat: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[1], argv + 1);
+      fprintf(2, "lockstat: exec %s failed\n", argv[1]);
+      exit(1);
+    }
+    wait(0);
+  }
+
+  if((n = lockstat(ls, NLOCKCLASS, 0)) < 0){
+    fprintf(2, "lockstat: lockstat failed\n");
+    exit(1);
+  }
+
+  // insertion sort by contended acquires, then by spin time.
+  for(i = 1; i < n; i++){
+    t = ls[i];
+    for(j = i; j > 0; j--){
+      if(ls[j-1].ncontend > t.ncontend ||
+         (ls[j-1].ncontend == t.ncontend && ls[j-1].nspin >= t.nspin))
+        break;
+      ls[j] = ls[j-1];
+    }
+    ls[j] = t;
+  }
+
+  printf("name: acquires contended spin-cycles [won-by-spinning slept]\n");
+  for(i = 0; i < n; i++){
+    if(ls[i].nacquire == 0)
+      continue;
+    printf("%s: %l %l %l", ls[i].name, ls[i].nacquire, ls[i].ncontend, ls[i].nspin);
+    if(ls[i].nspinwin || ls[i].nsleep)
+      printf(" %l %l", ls[i].nspinwin, ls[i].nsleep);
+    printf("\n");
+  }
+  exit(0);
+}
@@ -0,0 +1,24 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+// run a command at base priority n (0 is highest).
+int
+main(int argc, char *argv[])
+{
+  int n;
+
+  if(argc < 3 || argv[1][0] < '0' || argv[1][0] > '9'){
+    fprintf(2, "usage: nice priority command [args...]\n");
+    exit(1);
+  }
+  n = atoi(argv[1]);
+  if(setpriority(0, n) < 0){
+    fprintf(2, "nice: priority must be 0..%d\n", NPRIO-1);
+    exit(1);
+  }
+  exec(argv[2], argv+2);
+  fprintf(2, "nice: exec %s failed\n", argv[2]);
+  exit(1);
+}
@@ -0,0 +1,50 @@
+// measure the round trip into the kernel and back with
+// system calls that do next to nothing, against the same
+// calls answered from the VDSO page without a trap.
+// build with NOFASTCALL=1 to time the slow trap path.
+//
+// usage: nullbench [iters]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/date.h"
+#include "user/user.h"
+
+uint64
+nsnow(void)
+{
+  struct timespec ts;
+
+  vdso_clock_gettime(&ts);
+  return ts.sec * 1000000000 + ts.nsec;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int iters = 100000;
+  uint64 t0, sys, vdso;
+  volatile int sink = 0;
+
+  if(argc > 1)
+    iters = atoi(argv[1]);
+  if(iters < 1){
+    fprintf(2, "usage: nullbench [iters]\n");
+    exit(1);
+  }
+
+  t0 = nsnow();
+  for(int i = 0; i < iters; i++)
+    sink += getpid();
+  sys = nsnow() - t0;
+
+  t0 = nsnow();
+  for(int i = 0; i < iters; i++)
+    sink += vdso_getpid();
+  vdso = nsnow() - t0;
+
+  printf("nullbench: getpid: %d ns per call\n", (int)(sys / iters));
+  printf("nullbench: vdso_getpid: %d ns per call\n", (int)(vdso / iters));
+  printf("nullbench: trap round trip: %d ns\n", (int)((sys - vdso) / iters));
+  exit(0);
+}
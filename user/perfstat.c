@@ -0,0 +1,76 @@
+// run a command and report the cycles and instructions it
+// used, and its time in user space and in the kernel.
+//
+// usage: perfstat command [args...]
+//
+// counts include the command's children, once it has
+// waited for them.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/date.h"
+#include "kernel/memlayout.h"
+#include "kernel/param.h"
+#include "kernel/riscv.h"
+#include "kernel/spinlock.h"
+#include "kernel/proc.h"
+#include "kernel/perf.h"
+#include "user/user.h"
+
+// time CSR cycles to microseconds.
+#define USEC(t) ((t) / (MTIME_HZ / 1000000))
+
+static void
+hundredths(char *label, uint64 x, uint64 y)
+{
+  uint64 h = y ? x * 100 / y : 0;
+  printf("%s%l.%l%l\n", label, h / 100, (h / 10) % 10, h % 10);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct perfstat before, after;
+  struct timespec t0, t1;
+  uint64 cycles, instret, utime, stime, wall;
+  int pid, xstate;
+
+  if(argc < 2){
+    fprintf(2, "usage: perfstat command [args...]\n");
+    exit(1);
+  }
+
+  if(perfstat(&before, PERF_CHILDREN) < 0){
+    fprintf(2, "perfstat: perfstat failed\n");
+    exit(1);
+  }
+  clock_gettime(&t0);
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "perfstat: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "perfstat: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(&xstate);
+  clock_gettime(&t1);
+  perfstat(&after, PERF_CHILDREN);
+
+  cycles = after.cycles - before.cycles;
+  instret = after.instret - before.instret;
+  utime = after.utime - before.utime;
+  stime = after.stime - before.stime;
+  wall = ((t1.sec * 1000000000 + t1.nsec) - (t0.sec * 1000000000 + t0.nsec)) / 1000;
+
+  printf("\n%s: exit %d\n", argv[1], xstate);
+  printf("cycles       %l\n", cycles);
+  printf("instructions %l\n", instret);
+  hundredths("insn/cycle   ", instret, cycles);
+  printf("user         %l us\n", USEC(utime));
+  printf("sys          %l us\n", USEC(stime));
+  printf("elapsed      %l us\n", wall);
+  exit(0);
+}
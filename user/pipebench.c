@@ -0,0 +1,73 @@
+// pipe throughput for a range of buffer sizes: a child
+// streams bytes through a pipe to its parent, first with the
+// default buffer and then with buffers grown by fcntl().
+//
+// usage: pipebench [kbytes]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define CHUNK 8192
+
+char buf[CHUNK];
+
+int sizes[] = { 0, 4096, 16384, 65536 };
+
+void
+run(int size, int total)
+{
+  int fds[2], n, got = 0;
+
+  if(pipe(fds) < 0){
+    fprintf(2, "pipebench: pipe failed\n");
+    exit(1);
+  }
+  if(size && fcntl(fds[1], F_SETPIPE_SZ, size) != size){
+    fprintf(2, "pipebench: cannot set pipe size %d\n", size);
+    exit(1);
+  }
+  size = fcntl(fds[0], F_GETPIPE_SZ, 0);
+
+  int start = uptime();
+  if(fork() == 0){
+    close(fds[0]);
+    for(int left = total; left > 0; left -= n){
+      n = left < CHUNK ? left : CHUNK;
+      if(write(fds[1], buf, n) != n){
+        fprintf(2, "pipebench: write failed\n");
+        exit(1);
+      }
+    }
+    exit(0);
+  }
+  close(fds[1]);
+  while((n = read(fds[0], buf, sizeof(buf))) > 0)
+    got += n;
+  close(fds[0]);
+  wait(0);
+  int t = uptime() - start;
+
+  if(got != total){
+    fprintf(2, "pipebench: read %d bytes, expected %d\n", got, total);
+    exit(1);
+  }
+  printf("pipe size %d: %d KB in %d ticks\n", size, total / 1024, t);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int kbytes = 4096;
+
+  if(argc > 1)
+    kbytes = atoi(argv[1]);
+  if(kbytes < 1){
+    fprintf(2, "usage: pipebench [kbytes]\n");
+    exit(1);
+  }
+  for(int i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+    run(sizes[i], kbytes * 1024);
+  exit(0);
+}
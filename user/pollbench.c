@@ -0,0 +1,105 @@
+// poll() benchmark: one process reads from 64 pipes, fed by
+// 8 writer processes with 8 pipes each, using poll() to find
+// the pipes with data instead of one reader process per pipe.
+//
+// usage: pollbench [rounds]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/poll.h"
+#include "user/user.h"
+
+#define NPIPE 64
+#define NWRITER 8
+#define PERWRITER (NPIPE / NWRITER)
+#define MSG 8
+
+struct pollfd fds[NPIPE];
+
+void
+writer(int *wfds, int rounds)
+{
+  char msg[MSG];
+
+  memset(msg, 'x', sizeof(msg));
+  for(int r = 0; r < rounds; r++){
+    for(int j = 0; j < PERWRITER; j++){
+      if(write(wfds[j], msg, MSG) != MSG){
+        fprintf(2, "pollbench: write failed\n");
+        exit(1);
+      }
+    }
+  }
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rounds = 500;
+  int i, j, n, nopen, polls = 0;
+  int wfds[PERWRITER];
+  char buf[512];
+  uint64 total = 0;
+
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+  if(rounds < 1){
+    fprintf(2, "usage: pollbench [rounds]\n");
+    exit(1);
+  }
+
+  int start = uptime();
+
+  for(i = 0; i < NWRITER; i++){
+    for(j = 0; j < PERWRITER; j++){
+      int p[2];
+      if(pipe(p) < 0){
+        fprintf(2, "pollbench: pipe failed\n");
+        exit(1);
+      }
+      fds[i*PERWRITER + j].fd = p[0];
+      fds[i*PERWRITER + j].events = POLLIN;
+      wfds[j] = p[1];
+    }
+    if(fork() == 0){
+      for(j = 0; j < (i+1)*PERWRITER; j++)
+        close(fds[j].fd);
+      writer(wfds, rounds);
+    }
+    for(j = 0; j < PERWRITER; j++)
+      close(wfds[j]);
+  }
+
+  for(nopen = NPIPE; nopen > 0; ){
+    if((n = poll(fds, NPIPE, -1)) <= 0){
+      fprintf(2, "pollbench: poll failed\n");
+      exit(1);
+    }
+    polls++;
+    for(i = 0; i < NPIPE; i++){
+      if(fds[i].fd < 0 || fds[i].revents == 0)
+        continue;
+      if((n = read(fds[i].fd, buf, sizeof(buf))) > 0){
+        total += n;
+      } else {
+        // every writer has closed this pipe.
+        close(fds[i].fd);
+        fds[i].fd = -1;
+        nopen--;
+      }
+    }
+  }
+  for(i = 0; i < NWRITER; i++)
+    wait(0);
+
+  int t = uptime() - start;
+  if(total != (uint64)NPIPE * rounds * MSG){
+    printf("pollbench: read %d bytes, expected %d\n",
+           (int)total, NPIPE * rounds * MSG);
+    exit(1);
+  }
+  printf("pollbench: %d pipes, %d bytes, %d polls in %d ticks\n",
+         NPIPE, (int)total, polls, t);
+  exit(0);
+}
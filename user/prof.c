@@ -0,0 +1,296 @@
+// sample where every CPU spends its time while a command runs.
+//
+// usage: prof command [args...]
+//
+// prints a flat profile, the functions the ticks landed in,
+// most first; then one line per distinct call stack in the
+// folded format flame graph tools read:
+//
+//   process;outer;...;inner count
+//
+// kernel functions are marked _[k]. names come from
+// kernel.sym and <program>.sym, which "make PROF=1" puts
+// in the file system; without them pcs print in hex.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/prof.h"
+#include "user/user.h"
+
+#define NBATCH 32       // samples per prof() read
+#define NTAB   8        // symbol tables kept loaded
+#define NCOUNT 512      // distinct functions and stacks counted
+
+struct sym {
+  uint64 addr;
+  char *name;
+};
+
+struct symtab {
+  char name[16];        // program name, or "kernel"
+  struct sym *s;        // sorted by addr
+  int n;
+} tab[NTAB];
+int ntab;
+
+struct count {
+  char *key;
+  int n;
+};
+
+struct count flat[NCOUNT], folded[NCOUNT];
+int nflat, nfolded;
+int nsample, nlost;
+
+struct profsample batch[NBATCH];
+
+static uint64
+hex(char **pp)
+{
+  uint64 x = 0;
+  char *p = *pp;
+
+  for(;; p++){
+    if(*p >= '0' && *p <= '9')
+      x = x*16 + *p - '0';
+    else if(*p >= 'a' && *p <= 'f')
+      x = x*16 + *p - 'a' + 10;
+    else
+      break;
+  }
+  *pp = p;
+  return x;
+}
+
+// a symbol worth naming a pc after: not a section,
+// source file or local label.
+static int
+funcname(char *name)
+{
+  int n = strlen(name);
+
+  if(n == 0 || name[0] == '.' || name[0] == '$')
+    return 0;
+  if(n > 2 && name[n-2] == '.' && (name[n-1] == 'c' || name[n-1] == 'S'))
+    return 0;
+  return 1;
+}
+
+// Read "addr name" lines from path into t, sorted by addr.
+static int
+loadsyms(struct symtab *t, char *path)
+{
+  struct stat st;
+  char *buf, *p, *e;
+  struct sym x;
+  int fd, n, i, j;
+
+  if((fd = open(path, O_RDONLY)) < 0)
+    return -1;
+  if(fstat(fd, &st) < 0 || (buf = malloc(st.size + 1)) == 0){
+    close(fd);
+    return -1;
+  }
+  for(i = 0; i < st.size; i += n)
+    if((n = read(fd, buf + i, st.size - i)) <= 0)
+      break;
+  close(fd);
+  buf[i] = 0;
+
+  n = 0;
+  for(p = buf; *p; p++)
+    if(*p == '\n')
+      n++;
+  if((t->s = malloc((n + 1) * sizeof(struct sym))) == 0)
+    return -1;
+
+  for(p = buf; *p; p = e){
+    for(e = p; *e && *e != '\n'; e++)
+      ;
+    if(*e)
+      *e++ = 0;
+    x.addr = hex(&p);
+    if(*p++ != ' ' || !funcname(p))
+      continue;
+    x.name = p;
+    for(j = t->n; j > 0 && t->s[j-1].addr > x.addr; j--)
+      t->s[j] = t->s[j-1];
+    t->s[j] = x;
+    t->n++;
+  }
+  return 0;
+}
+
+// Copy s to p, truncating it to end before e, where the
+// buffer ends. Returns the end of what is now in p.
+static char*
+append(char *p, char *e, char *s)
+{
+  while(*s && p < e - 1)
+    *p++ = *s++;
+  *p = 0;
+  return p;
+}
+
+// The symbol table for a program, loading it on first use.
+// A program without a .sym file gets an empty table.
+static struct symtab*
+symtab(char *name)
+{
+  char path[32];
+  struct symtab *t;
+  int i;
+
+  for(i = 0; i < ntab; i++)
+    if(strcmp(tab[i].name, name) == 0)
+      return &tab[i];
+  if(ntab == NTAB)
+    return 0;
+  t = &tab[ntab++];
+  append(t->name, t->name + sizeof(t->name), name);
+  append(append(path, path + sizeof(path), name), path + sizeof(path), ".sym");
+  loadsyms(t, path);
+  return t;
+}
+
+// Append the name of the function containing pc to buf,
+// which ends at e. Returns the end of the name.
+static char*
+lookup(char *buf, char *e, struct symtab *t, uint64 pc, int kernel)
+{
+  int lo = 0, hi = t ? t->n : 0, mid;
+
+  // the last symbol at or below pc.
+  while(lo < hi){
+    mid = (lo + hi) / 2;
+    if(t->s[mid].addr <= pc)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if(lo > 0){
+    buf = append(buf, e, t->s[lo-1].name);
+  } else {
+    static char digits[] = "0123456789abcdef";
+    char hex[19], *p = hex;
+    int i;
+    *p++ = '0';
+    *p++ = 'x';
+    for(i = 60; i >= 0; i -= 4)
+      if((pc >> i) || i == 0)
+        *p++ = digits[(pc >> i) & 0xf];
+    *p = 0;
+    buf = append(buf, e, hex);
+  }
+  if(kernel)
+    buf = append(buf, e, "_[k]");
+  return buf;
+}
+
+static void
+count(struct count *c, int *n, char *key)
+{
+  int i;
+
+  for(i = 0; i < *n; i++){
+    if(strcmp(c[i].key, key) == 0){
+      c[i].n++;
+      return;
+    }
+  }
+  if(*n == NCOUNT){
+    nlost++;
+    return;
+  }
+  if((c[i].key = malloc(strlen(key) + 1)) == 0){
+    nlost++;
+    return;
+  }
+  strcpy(c[i].key, key);
+  c[i].n = 1;
+  (*n)++;
+}
+
+static void
+sample(struct profsample *s)
+{
+  char leaf[80], stack[80 * (PROFDEPTH + 1)], *p, *e;
+  struct symtab *t;
+  int i;
+
+  t = s->user ? symtab(s->name) : symtab("kernel");
+
+  lookup(leaf, leaf + sizeof(leaf), t, s->pc[0], !s->user);
+  count(flat, &nflat, leaf);
+
+  // pc[0] is the innermost frame; folded stacks go outermost
+  // first. a long stack loses its innermost names.
+  e = stack + sizeof(stack);
+  p = append(stack, e, s->pid ? s->name : "scheduler");
+  for(i = s->depth - 1; i >= 0; i--){
+    p = append(p, e, ";");
+    p = lookup(p, e, t, s->pc[i], !s->user);
+  }
+  count(folded, &nfolded, stack);
+  nsample++;
+}
+
+static void
+sort(struct count *c, int n)
+{
+  struct count t;
+  int i, j;
+
+  for(i = 1; i < n; i++){
+    t = c[i];
+    for(j = i; j > 0 && c[j-1].n < t.n; j--)
+      c[j] = c[j-1];
+    c[j] = t;
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, pid, dropped;
+
+  if(argc < 2){
+    fprintf(2, "usage: prof command [args...]\n");
+    exit(1);
+  }
+
+  if(prof(PROF_START, 0, 0) < 0){
+    fprintf(2, "prof: cannot start profiling\n");
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "prof: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "prof: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  dropped = prof(PROF_STOP, 0, 0);
+
+  while((n = prof(PROF_READ, batch, NBATCH)) > 0)
+    for(i = 0; i < n; i++)
+      sample(&batch[i]);
+
+  sort(flat, nflat);
+  sort(folded, nfolded);
+
+  printf("%d samples, %d dropped\n", nsample, dropped);
+  for(i = 0; i < nflat; i++)
+    printf("%d %d%% %s\n", flat[i].n, flat[i].n * 100 / nsample, flat[i].key);
+  printf("\n");
+  for(i = 0; i < nfolded; i++)
+    printf("%s %d\n", folded[i].key, folded[i].n);
+  if(nlost)
+    printf("%d samples not counted: too many distinct stacks\n", nlost);
+  exit(0);
+}
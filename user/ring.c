@@ -0,0 +1,83 @@
+// Helpers for the submission/completion rings of
+// kernel/ring.h. A process has at most one ring.
+
+#include "kernel/types.h"
+#include "kernel/ring.h"
+#include "user/user.h"
+
+// does a kernel thread poll the ring?
+static int sqpoll;
+
+// Register r as the process's ring. flags may be RING_SQPOLL.
+int
+ring_init(struct ring *r, int flags)
+{
+  if(ring_setup(r, flags) < 0)
+    return -1;
+  sqpoll = (flags & RING_SQPOLL) != 0;
+  return 0;
+}
+
+// Queue a submission for the kernel.
+// Returns 0, or -1 if the submission ring is full.
+int
+ring_queue(struct ring *r, int op, int fd, void *addr, int n, uint64 data)
+{
+  uint tail = r->sqtail;
+  struct sqe *e;
+
+  if(tail - *(volatile uint *)&r->sqhead >= RINGSIZE)
+    return -1;
+  e = &r->sq[tail % RINGSIZE];
+  e->op = op;
+  e->fd = fd;
+  e->addr = (uint64)addr;
+  e->n = n;
+  e->data = data;
+  // the kernel must see the sqe before the new tail.
+  __sync_synchronize();
+  r->sqtail = tail + 1;
+  return 0;
+}
+
+// Have the kernel take the queued submissions: with a poller
+// this makes a system call only if the poller is asleep.
+// Returns the number taken, or 0 if the poller takes them.
+int
+ring_submit(struct ring *r)
+{
+  __sync_synchronize();
+  if(sqpoll && (*(volatile uint *)&r->flags & RING_NEEDWAKE) == 0)
+    return 0;
+  return ring_enter();
+}
+
+// Take a completion, if there is one.
+// Returns 0, or -1 if the completion ring is empty.
+int
+ring_reap(struct ring *r, struct cqe *c)
+{
+  uint head = r->cqhead;
+
+  if(head == *(volatile uint *)&r->cqtail)
+    return -1;
+  // read the cqe only after the tail that covers it.
+  __sync_synchronize();
+  *c = r->cq[head % RINGSIZE];
+  __sync_synchronize();
+  r->cqhead = head + 1;
+  return 0;
+}
+
+// Wait for a completion. Without a poller, completions are
+// all posted by ring_submit(), so this fails if there is none.
+int
+ring_wait(struct ring *r, struct cqe *c)
+{
+  while(ring_reap(r, c) < 0){
+    if(!sqpoll)
+      return -1;
+    ring_submit(r);
+  }
+  return 0;
+}
@@ -0,0 +1,115 @@
+// compare small writes to a pipe made one write() at a time
+// with the same writes batched through a submission ring,
+// and through a ring with a kernel poller (RING_SQPOLL).
+//
+// usage: ringbench [nwrites]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/ring.h"
+#include "user/user.h"
+
+#define RECSIZE 16
+
+char rec[RECSIZE];
+
+// start a child that reads and discards until EOF;
+// return the pipe's write end.
+int
+drain(void)
+{
+  int fds[2];
+  char buf[512];
+
+  if(pipe(fds) < 0){
+    fprintf(2, "ringbench: pipe failed\n");
+    exit(1);
+  }
+  if(fork() == 0){
+    close(fds[1]);
+    while(read(fds[0], buf, sizeof(buf)) > 0)
+      ;
+    exit(0);
+  }
+  close(fds[0]);
+  return fds[1];
+}
+
+void
+finish(char *name, int fd, int start, int nwrites)
+{
+  close(fd);
+  wait(0);
+  printf("ringbench: %s: %d writes in %d ticks\n", name, nwrites, uptime() - start);
+}
+
+void
+plain(int nwrites)
+{
+  int fd = drain();
+  int start = uptime();
+
+  for(int i = 0; i < nwrites; i++){
+    if(write(fd, rec, RECSIZE) != RECSIZE){
+      fprintf(2, "ringbench: write failed\n");
+      exit(1);
+    }
+  }
+  finish("write", fd, start, nwrites);
+}
+
+// in a child, since a process has only one ring.
+void
+ring(char *name, int flags, int nwrites)
+{
+  struct ring *r;
+  struct cqe c;
+  int pid, xst;
+
+  if((pid = fork()) != 0){
+    wait(&xst);
+    if(xst != 0)
+      exit(1);
+    return;
+  }
+
+  int fd = drain();
+  if((r = malloc(sizeof(*r))) == 0 || ring_init(r, flags) < 0){
+    fprintf(2, "ringbench: ring_init failed\n");
+    exit(1);
+  }
+  int start = uptime();
+  int queued = 0, done = 0;
+  while(done < nwrites){
+    while(queued < nwrites && ring_queue(r, RING_WRITE, fd, rec, RECSIZE, queued) == 0)
+      queued++;
+    ring_submit(r);
+    while(done < queued && ring_wait(r, &c) == 0){
+      if(c.res != RECSIZE){
+        fprintf(2, "ringbench: ring write failed\n");
+        exit(1);
+      }
+      done++;
+    }
+  }
+  finish(name, fd, start, nwrites);
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nwrites = 20000;
+
+  if(argc > 1)
+    nwrites = atoi(argv[1]);
+  if(nwrites < 1){
+    fprintf(2, "usage: ringbench [nwrites]\n");
+    exit(1);
+  }
+
+  plain(nwrites);
+  ring("ring", 0, nwrites);
+  ring("ring+sqpoll", RING_SQPOLL, nwrites);
+  exit(0);
+}
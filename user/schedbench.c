@@ -0,0 +1,81 @@
+// Scheduling latency benchmark.
+//
+// An interactive process repeatedly sleeps for one tick and does a
+// little work, first on an idle machine and then while CPU-bound
+// "hog" processes run. Each wakeup should get the CPU back within
+// about a tick; under plain round-robin it has to wait for the hogs'
+// time slices as well.
+//
+// usage: schedbench [nhogs [hog-priority]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define WAKEUPS 20
+
+volatile int sink;
+
+// sleep/wake WAKEUPS times; return the number of ticks it took.
+int
+interactive(void)
+{
+  int start = uptime();
+
+  for(int i = 0; i < WAKEUPS; i++){
+    sleep(1);
+    for(int j = 0; j < 1000; j++)
+      sink += j;
+  }
+  return uptime() - start;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nhogs = 8;
+  int hogprio = -1;
+  int pids[NPROC];
+  int i, t;
+
+  if(argc > 1)
+    nhogs = atoi(argv[1]);
+  if(argc > 2)
+    hogprio = atoi(argv[2]);
+  if(nhogs < 0 || nhogs > NPROC/2){
+    fprintf(2, "schedbench: bad hog count\n");
+    exit(1);
+  }
+
+  t = interactive();
+  printf("schedbench: idle: %d wakeups in %d ticks\n", WAKEUPS, t);
+
+  for(i = 0; i < nhogs; i++){
+    pids[i] = fork();
+    if(pids[i] < 0){
+      fprintf(2, "schedbench: fork failed\n");
+      nhogs = i;
+      break;
+    }
+    if(pids[i] == 0){
+      if(hogprio >= 0)
+        setpriority(0, hogprio);
+      for(;;)
+        sink++;
+    }
+  }
+
+  // let the hogs use up their first time slices.
+  sleep(5);
+
+  t = interactive();
+  printf("schedbench: %d hogs at priority %d: %d wakeups in %d ticks\n",
+         nhogs, hogprio >= 0 ? hogprio : getpriority(0), WAKEUPS, t);
+
+  for(i = 0; i < nhogs; i++)
+    kill(pids[i]);
+  for(i = 0; i < nhogs; i++)
+    wait(0);
+  exit(0);
+}
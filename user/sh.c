@@ -201,6 +201,73 @@ void runcmd(struct cmd *cmd) {
   exit(0);
 }
 
+// Can cmd run without forking the shell, by spawn()ing
+// each of its programs?
+int canspawn(struct cmd *cmd) {
+  switch (cmd->type) {
+  case EXEC:
+    return 1;
+  case REDIR:
+    return canspawn(((struct redircmd *)cmd)->cmd);
+  case PIPE:
+    return canspawn(((struct pipecmd *)cmd)->left) &&
+           canspawn(((struct pipecmd *)cmd)->right);
+  }
+  return 0;
+}
+
+// Start the programs of cmd with spawn(), with fds[0..2] as their
+// standard input, output and error, so that the shell's memory is
+// never copied. Returns the number of processes started.
+int spawncmd(struct cmd *cmd, int *fds) {
+  int p[2], nfds[3], fd, n;
+  struct execcmd *ecmd;
+  struct pipecmd *pcmd;
+  struct redircmd *rcmd;
+
+  switch (cmd->type) {
+  default:
+    panic("spawncmd");
+
+  case EXEC:
+    ecmd = (struct execcmd *)cmd;
+    if (ecmd->argv[0] == 0)
+      return 0;
+    if (spawn(ecmd->argv[0], ecmd->argv, fds, 3) < 0) {
+      fprintf(2, "exec %s failed\n", ecmd->argv[0]);
+      return 0;
+    }
+    return 1;
+
+  case REDIR:
+    rcmd = (struct redircmd *)cmd;
+    if ((fd = open(rcmd->file, rcmd->mode)) < 0) {
+      fprintf(2, "open %s failed\n", rcmd->file);
+      return 0;
+    }
+    memmove(nfds, fds, sizeof(nfds));
+    nfds[rcmd->fd] = fd;
+    n = spawncmd(rcmd->cmd, nfds);
+    close(fd);
+    return n;
+
+  case PIPE:
+    pcmd = (struct pipecmd *)cmd;
+    if (pipe(p) < 0)
+      panic("pipe");
+    memmove(nfds, fds, sizeof(nfds));
+    nfds[1] = p[1];
+    n = spawncmd(pcmd->left, nfds);
+    close(p[1]);
+    memmove(nfds, fds, sizeof(nfds));
+    nfds[0] = p[0];
+    n += spawncmd(pcmd->right, nfds);
+    close(p[0]);
+    return n;
+  }
+  return 0;
+}
+
 char *gets_with_tab(char *buf, int max) {
   int i = 0, cc, fd;
   char c, *ci, *in;
@@ -270,7 +337,8 @@ int getcmd(char *buf, int nbuf) {
 
 int main(void) {
   static char buf[100];
-  int fd;
+  static int stdfds[3] = {0, 1, 2};
+  int fd, n;
   struct cmd *cmd;
 
   // Ensure that three file descriptors are open.
@@ -290,7 +358,10 @@ int main(void) {
     cmd = parsecmd(buf);
     if (cmd->type == BUILTIN)
       builtin((struct builtincmd *)cmd);
-    else if (fork1() == 0)
+    else if (canspawn(cmd)) {
+      for (n = spawncmd(cmd, stdfds); n > 0; n--)
+        wait(0);
+    } else if (fork1() == 0)
       runcmd(cmd);
     else
       wait(0);
@@ -0,0 +1,82 @@
+// print system call counts and latency histograms, the
+// calls that took the most time in all first.
+//
+// usage: sysstat [-z] [command [args...]]
+//
+// -z zeroes the counts. with a command, zero them, run the
+// command, and report only the calls made while it ran.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memlayout.h"
+#include "kernel/sysstat.h"
+#include "user/user.h"
+
+#define NSTAT 64        // more than there are system calls
+
+// time CSR cycles to microseconds.
+#define USEC(t) ((t) / (MTIME_HZ / 1000000))
+
+struct sysstat ss[NSTAT];
+
+int
+main(int argc, char *argv[])
+{
+  int i, j, b, n;
+  struct sysstat t;
+
+  if(argc > 1 && strcmp(argv[1], "-z") == 0){
+    sysstat(0, 0, 1);
+    argc--;
+    argv++;
+    if(argc == 1)
+      exit(0);
+  }
+
+  if(argc > 1){
+    sysstat(0, 0, 1);
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "sysstat: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[1], argv + 1);
+      fprintf(2, "sysstat: exec %s failed\n", argv[1]);
+      exit(1);
+    }
+    wait(0);
+  }
+
+  if((n = sysstat(ss, NSTAT, 0)) < 0){
+    fprintf(2, "sysstat: sysstat failed\n");
+    exit(1);
+  }
+
+  // insertion sort by total time, then by calls.
+  for(i = 1; i < n; i++){
+    t = ss[i];
+    for(j = i; j > 0; j--){
+      if(ss[j-1].time > t.time ||
+         (ss[j-1].time == t.time && ss[j-1].ncall >= t.ncall))
+        break;
+      ss[j] = ss[j-1];
+    }
+    ss[j] = t;
+  }
+
+  // each histogram bucket is labelled with the longest
+  // call it counts, in time CSR cycles.
+  printf("name: calls total-us avg-us [cycles<=N: calls ...]\n");
+  for(i = 0; i < n; i++){
+    if(ss[i].ncall == 0)
+      continue;
+    printf("%s: %l %l %l ", ss[i].name, ss[i].ncall, USEC(ss[i].time),
+           USEC(ss[i].time / ss[i].ncall));
+    for(b = 0; b < NSYSHIST; b++)
+      if(ss[i].hist[b])
+        printf(" %l:%l", (2L << b) - 1, ss[i].hist[b]);
+    printf("\n");
+  }
+  exit(0);
+}
@@ -0,0 +1,102 @@
+// Threads, on top of the clone() and join() system calls.
+// Each thread runs on its own malloc()ed stack, which
+// thread_join() frees.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define TSTACK (4*4096)  // bytes of user stack per thread
+
+// sits at the bottom of a new thread's stack.
+struct tstart {
+  void (*fn)(void*);
+  void *arg;
+};
+
+static struct {
+  int tid;
+  void *stack;
+} threads[NPROC];
+
+// protects threads[] and malloc(), which are not thread-safe.
+static uint tlock;
+
+static void
+lock(void)
+{
+  while(__sync_lock_test_and_set(&tlock, 1) != 0)
+    ;
+  __sync_synchronize();
+}
+
+static void
+unlock(void)
+{
+  __sync_synchronize();
+  __sync_lock_release(&tlock);
+}
+
+static void
+thread_start(void *a)
+{
+  struct tstart *t = a;
+
+  t->fn(t->arg);
+  exit(0);
+}
+
+// Start a thread running fn(arg).
+// Returns its thread id, or -1.
+int
+thread_create(void (*fn)(void*), void *arg)
+{
+  char *stack;
+  struct tstart *t;
+  int i, tid;
+
+  // hold the lock until threads[] records the new thread,
+  // so that thread_join() always finds its stack.
+  lock();
+  for(i = 0; i < NPROC; i++)
+    if(threads[i].stack == 0)
+      break;
+  if(i == NPROC || (stack = malloc(TSTACK)) == 0){
+    unlock();
+    return -1;
+  }
+  t = (struct tstart *)stack;
+  t->fn = fn;
+  t->arg = arg;
+  tid = clone(thread_start, t, (void*)((uint64)(stack + TSTACK) & ~15L));
+  if(tid < 0){
+    free(stack);
+    unlock();
+    return -1;
+  }
+  threads[i].tid = tid;
+  threads[i].stack = stack;
+  unlock();
+  return tid;
+}
+
+// Wait for thread tid to finish, and free its stack.
+// Returns tid, or -1 if it is not a thread this thread created.
+int
+thread_join(int tid)
+{
+  if(join(tid) < 0)
+    return -1;
+
+  lock();
+  for(int i = 0; i < NPROC; i++){
+    if(threads[i].stack && threads[i].tid == tid){
+      free(threads[i].stack);
+      threads[i].stack = 0;
+      break;
+    }
+  }
+  unlock();
+  return tid;
+}
@@ -0,0 +1,170 @@
+// show the processes using the most CPU, refreshed until
+// return is pressed.
+//
+// usage: top [-d ms] [-n count]
+//
+// -d sets the refresh interval (default 200ms), -n stops
+// after count refreshes. the counts in a refresh are what
+// each process did since the one before, except TIME,
+// which is a total.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/memlayout.h"
+#include "kernel/date.h"
+#include "kernel/poll.h"
+#include "kernel/riscv.h"
+#include "kernel/spinlock.h"
+#include "kernel/proc.h"
+#include "kernel/procstat.h"
+#include "user/user.h"
+
+struct procstat cur[NPROC], prev[NPROC];
+int ncur, nprev;
+
+// per process, the CPU time since the last refresh.
+uint64 busy[NPROC];
+int order[NPROC];
+
+// S sleeping, W waiting for a CPU, R running, Z zombie, N new.
+char *states[] = { "-", "N", "S", "W", "R", "Z" };
+
+#define NELEM(x) (sizeof(x)/sizeof((x)[0]))
+
+// Print s right-aligned in w columns.
+static void
+col(char *s, int w)
+{
+  for(w -= strlen(s); w > 0; w--)
+    printf(" ");
+  printf("%s", s);
+}
+
+static void
+num(uint64 x, int w)
+{
+  char buf[24];
+  int i = sizeof(buf) - 1;
+
+  buf[i] = 0;
+  do {
+    buf[--i] = '0' + x % 10;
+    x /= 10;
+  } while(x);
+  col(buf + i, w);
+}
+
+static struct procstat*
+previous(struct procstat *ps)
+{
+  for(int i = 0; i < nprev; i++)
+    if(prev[i].pid == ps->pid && strcmp(prev[i].name, ps->name) == 0)
+      return &prev[i];
+  return 0;
+}
+
+static uint64
+now(void)
+{
+  struct timespec ts;
+
+  vdso_clock_gettime(&ts);
+  return ts.sec * 1000000000 + ts.nsec;
+}
+
+static void
+show(uint64 interval)
+{
+  struct procstat *ps, *pp, zero;
+  int i, j, t;
+
+  memset(&zero, 0, sizeof(zero));
+  for(i = 0; i < ncur; i++){
+    ps = &cur[i];
+    if((pp = previous(ps)) == 0)
+      pp = &zero;
+    busy[i] = (ps->perf.utime + ps->perf.stime) - (pp->perf.utime + pp->perf.stime);
+    // insertion sort, busiest first.
+    for(j = i; j > 0 && busy[order[j-1]] < busy[i]; j--)
+      order[j] = order[j-1];
+    order[j] = i;
+  }
+
+  // home the cursor and clear the screen.
+  printf("\033[H\033[J");
+  printf("%d processes, refreshed every %dms; return quits\n",
+         ncur, (int)(interval / 1000000));
+  printf("  PID PPID S PRI CPU %%CPU  TIME(ms)  VCSW IVCSW  BRD  BWR  PIPE-R  PIPE-W  MEM(K) NAME\n");
+  for(i = 0; i < ncur; i++){
+    ps = &cur[order[i]];
+    if((pp = previous(ps)) == 0)
+      pp = &zero;
+    num(ps->pid, 5);
+    num(ps->ppid, 5);
+    col(ps->state >= 0 && ps->state < NELEM(states) ? states[ps->state] : "?", 2);
+    num(ps->prio, 4);
+    num(ps->cpu, 4);
+    // interval is in ns, busy in time CSR cycles.
+    t = interval ? busy[order[i]] * 100 / (interval / (1000000000 / MTIME_HZ)) : 0;
+    num(t, 5);
+    num((ps->perf.utime + ps->perf.stime) / (MTIME_HZ / 1000), 10);
+    num(ps->use.nvcsw - pp->use.nvcsw, 6);
+    num(ps->use.nivcsw - pp->use.nivcsw, 6);
+    num(ps->use.nbread - pp->use.nbread, 5);
+    num(ps->use.nbwrite - pp->use.nbwrite, 5);
+    num(ps->use.npiperead - pp->use.npiperead, 8);
+    num(ps->use.npipewrite - pp->use.npipewrite, 8);
+    num(ps->sz / 1024, 8);
+    printf(" %s", ps->name);
+    if(ps->nthread > 1)
+      printf(" (%d threads)", ps->nthread);
+    printf("\n");
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct pollfd pfd;
+  int i, delay = 200, count = -1;
+  uint64 t, last;
+  char buf[64];
+
+  for(i = 1; i + 1 < argc; i += 2){
+    if(strcmp(argv[i], "-d") == 0)
+      delay = atoi(argv[i+1]);
+    else if(strcmp(argv[i], "-n") == 0)
+      count = atoi(argv[i+1]);
+    else
+      break;
+  }
+  if(i < argc || delay <= 0){
+    fprintf(2, "usage: top [-d ms] [-n count]\n");
+    exit(1);
+  }
+
+  last = now();
+  nprev = procstat(prev, NPROC);
+  while(count != 0){
+    pfd.fd = 0;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if(poll(&pfd, 1, delay) > 0){
+      read(0, buf, sizeof(buf));
+      break;
+    }
+    t = now();
+    if((ncur = procstat(cur, NPROC)) < 0){
+      fprintf(2, "top: procstat failed\n");
+      exit(1);
+    }
+    show(t - last);
+    memmove(prev, cur, ncur * sizeof(cur[0]));
+    nprev = ncur;
+    last = t;
+    if(count > 0)
+      count--;
+  }
+  exit(0);
+}
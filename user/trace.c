@@ -0,0 +1,222 @@
+// trace kernel events while a command runs, and print them
+// merged into one timeline across CPUs.
+//
+// usage: trace command [args...]
+//
+// each line is: microseconds since the first event, cpu, pid,
+// event and its arguments. an event that ends something (a
+// system call, a disk request, a log commit) also shows how
+// long it took, in microseconds, after a +.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/memlayout.h"
+#include "kernel/syscall.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+#define NBATCH 64       // events per trace() read
+#define NPEND  64       // unfinished syscalls and disk requests remembered
+
+#define NELEM(x) (sizeof(x)/sizeof((x)[0]))
+
+char *sysname[] = {
+  [SYS_fork] "fork", [SYS_exit] "exit", [SYS_wait] "wait",
+  [SYS_pipe] "pipe", [SYS_read] "read", [SYS_kill] "kill",
+  [SYS_exec] "exec", [SYS_fstat] "fstat", [SYS_chdir] "chdir",
+  [SYS_dup] "dup", [SYS_getpid] "getpid", [SYS_sbrk] "sbrk",
+  [SYS_sleep] "sleep", [SYS_uptime] "uptime", [SYS_open] "open",
+  [SYS_write] "write", [SYS_mknod] "mknod", [SYS_unlink] "unlink",
+  [SYS_link] "link", [SYS_mkdir] "mkdir", [SYS_close] "close",
+  [SYS_setpriority] "setpriority", [SYS_getpriority] "getpriority",
+  [SYS_clone] "clone", [SYS_join] "join",
+  [SYS_futex_wait] "futex_wait", [SYS_futex_wake] "futex_wake",
+  [SYS_spawn] "spawn", [SYS_nanosleep] "nanosleep",
+  [SYS_clock_gettime] "clock_gettime", [SYS_ring_setup] "ring_setup",
+  [SYS_ring_enter] "ring_enter", [SYS_poll] "poll",
+  [SYS_fcntl] "fcntl", [SYS_splice] "splice", [SYS_tee] "tee",
+  [SYS_copy_file_range] "copy_file_range", [SYS_lockstat] "lockstat",
+  [SYS_prof] "prof", [SYS_perfstat] "perfstat", [SYS_trace] "trace",
+};
+
+char *states[] = { "unused", "used", "sleep", "runnable", "run", "zombie" };
+
+struct traceevent *ev, *tmp;
+int nev;
+
+// the start of something an event will end: a system call
+// (keyed by pid) or a disk request (keyed by block number).
+struct pending {
+  int type;
+  uint64 key;
+  uint64 time;
+} pend[NPEND];
+uint64 committime;
+
+static void
+begin(int type, uint64 key, uint64 time)
+{
+  struct pending *p, *empty = 0;
+
+  for(p = pend; p < &pend[NPEND]; p++){
+    if(p->type == type && p->key == key)
+      break;
+    if(p->type == 0 && empty == 0)
+      empty = p;
+  }
+  if(p == &pend[NPEND])
+    p = empty;
+  if(p){
+    p->type = type;
+    p->key = key;
+    p->time = time;
+  }
+}
+
+// Print how long since the matching begin(), if there was one.
+static void
+end(int type, uint64 key, uint64 time)
+{
+  struct pending *p;
+
+  for(p = pend; p < &pend[NPEND]; p++){
+    if(p->type == type && p->key == key){
+      printf(" +%l", (time - p->time) / (MTIME_HZ / 1000000));
+      p->type = 0;
+      return;
+    }
+  }
+}
+
+static char*
+name(uint64 num)
+{
+  if(num < NELEM(sysname) && sysname[num])
+    return sysname[num];
+  return "?";
+}
+
+static void
+show(struct traceevent *e, uint64 t0)
+{
+  uint64 t = (e->time - t0) / (MTIME_HZ / 10000000);
+
+  printf("%l.%l %d %d ", t / 10, t % 10, e->cpu, e->pid);
+  switch(e->type){
+  case TR_SYSENTER:
+    printf("%s(%p)", name(e->arg[0]), e->arg[1]);
+    begin(TR_SYSENTER, e->pid, e->time);
+    break;
+  case TR_SYSEXIT:
+    printf("%s = %d", name(e->arg[0]), (int)e->arg[1]);
+    end(TR_SYSENTER, e->pid, e->time);
+    break;
+  case TR_SWITCH:
+    printf("switch %s", e->arg[0] < NELEM(states) ? states[e->arg[0]] : "?");
+    if(e->arg[1])
+      printf(" on %p", e->arg[1]);
+    break;
+  case TR_RUN:
+    printf("run prio %d", (int)e->arg[0]);
+    break;
+  case TR_BREAD:
+    printf("bread %d%s", (int)e->arg[0], e->arg[1] ? "" : " miss");
+    break;
+  case TR_BWRITE:
+    printf("bwrite %d", (int)e->arg[0]);
+    break;
+  case TR_COMMIT:
+    printf("commit %d blocks", (int)e->arg[0]);
+    committime = e->time;
+    break;
+  case TR_COMMITDONE:
+    printf("commit done");
+    if(committime)
+      printf(" +%l", (e->time - committime) / (MTIME_HZ / 1000000));
+    committime = 0;
+    break;
+  case TR_DISK:
+    printf("disk %s %d", e->arg[1] ? "write" : "read", (int)e->arg[0]);
+    begin(TR_DISK, e->arg[0], e->time);
+    break;
+  case TR_DISKDONE:
+    printf("disk done %d", (int)e->arg[0]);
+    end(TR_DISK, e->arg[0], e->time);
+    break;
+  default:
+    printf("event %d", e->type);
+  }
+  printf("\n");
+}
+
+// Sort ev[lo, hi) by time. Each CPU's events arrive in
+// order, so the runs merged are long and this is cheap.
+static void
+sort(int lo, int hi)
+{
+  int mid = (lo + hi) / 2, i, j, k;
+
+  if(hi - lo < 2)
+    return;
+  sort(lo, mid);
+  sort(mid, hi);
+  if(ev[mid-1].time <= ev[mid].time)
+    return;
+  i = lo, j = mid;
+  for(k = lo; k < hi; k++){
+    if(j == hi || (i < mid && ev[i].time <= ev[j].time))
+      tmp[k] = ev[i++];
+    else
+      tmp[k] = ev[j++];
+  }
+  memmove(ev + lo, tmp + lo, (hi - lo) * sizeof(ev[0]));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, pid, dropped;
+
+  if(argc < 2){
+    fprintf(2, "usage: trace command [args...]\n");
+    exit(1);
+  }
+
+  ev = malloc(NCPU * NTRACE * sizeof(ev[0]));
+  tmp = malloc(NCPU * NTRACE * sizeof(ev[0]));
+  if(ev == 0 || tmp == 0){
+    fprintf(2, "trace: out of memory\n");
+    exit(1);
+  }
+
+  if(trace(TRACE_START, 0, 0) < 0){
+    fprintf(2, "trace: cannot start tracing\n");
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "trace: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "trace: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  dropped = trace(TRACE_STOP, 0, 0);
+
+  while(nev < NCPU * NTRACE){
+    n = NCPU * NTRACE - nev;
+    if((n = trace(TRACE_READ, ev + nev, n < NBATCH ? n : NBATCH)) <= 0)
+      break;
+    nev += n;
+  }
+  sort(0, nev);
+
+  for(i = 0; i < nev; i++)
+    show(&ev[i], ev[0].time);
+  printf("%d events, %d dropped\n", nev, dropped);
+  exit(0);
+}
@@ -1,6 +1,11 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/param.h"
+#include "kernel/memlayout.h"
+#include "kernel/riscv.h"
+#include "kernel/date.h"
+#include "kernel/vdso.h"
 #include "user/user.h"
 
 char*
@@ -134,3 +139,105 @@ memcpy(void *dst, const void *src, uint n)
 {
   return memmove(dst, src, n);
 }
+
+// Mutexes that sleep in the kernel instead of spinning,
+// using futex_wait() and futex_wake().
+// state is 0 if unlocked, 1 if locked, and 2 if locked
+// and some thread may be waiting for it.
+
+void
+mutex_init(struct mutex *m)
+{
+  m->state = 0;
+}
+
+void
+mutex_lock(struct mutex *m)
+{
+  int c;
+
+  if((c = __sync_val_compare_and_swap(&m->state, 0, 1)) == 0)
+    return;
+  // announce a waiter by setting state to 2 before sleeping,
+  // so that the holder's mutex_unlock() wakes us.
+  if(c != 2)
+    c = __sync_lock_test_and_set(&m->state, 2);
+  while(c != 0){
+    futex_wait(&m->state, 2);
+    c = __sync_lock_test_and_set(&m->state, 2);
+  }
+}
+
+void
+mutex_unlock(struct mutex *m)
+{
+  if(__sync_fetch_and_sub(&m->state, 1) != 1){
+    m->state = 0;
+    __sync_synchronize();
+    futex_wake(&m->state, 1);
+  }
+}
+
+// Condition variables. seq changes on every signal, so a
+// waiter that sampled it before releasing the mutex does
+// not sleep through a signal that comes in between.
+
+void
+cond_init(struct cond *c)
+{
+  c->seq = 0;
+}
+
+void
+cond_wait(struct cond *c, struct mutex *m)
+{
+  int seq = c->seq;
+
+  mutex_unlock(m);
+  futex_wait(&c->seq, seq);
+  mutex_lock(m);
+}
+
+void
+cond_signal(struct cond *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake(&c->seq, 1);
+}
+
+void
+cond_broadcast(struct cond *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake(&c->seq, NPROC);
+}
+
+// The clock and pid, read from the VDSO pages that the
+// kernel maps into every process, without a system call.
+
+// like uptime().
+int
+vdso_uptime(void)
+{
+  return *(volatile uint *)&((struct vdso *)VDSO)->ticks;
+}
+
+// the process's pid. unlike getpid(), the same in all
+// of its threads.
+int
+vdso_getpid(void)
+{
+  return ((struct vdsoproc *)VDSOPROC)->pid;
+}
+
+// like clock_gettime(), from the time CSR.
+int
+vdso_clock_gettime(struct timespec *ts)
+{
+  uint64 hz = ((struct vdso *)VDSO)->hz;
+  uint64 now = r_time();
+
+  ts->sec = now / hz;
+  ts->nsec = (now % hz) * (1000000000 / hz);
+  return 0;
+}
@@ -1,5 +1,15 @@
 struct stat;
 struct rtcdate;
+struct timespec;
+struct ring;
+struct cqe;
+struct pollfd;
+struct lockstat;
+struct profsample;
+struct perfstat;
+struct traceevent;
+struct sysstat;
+struct procstat;
 
 // system calls
 int fork(void);
@@ -23,6 +33,28 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int setpriority(int, int);
+int getpriority(int);
+int clone(void(*)(void*), void*, void*);
+int join(int);
+int futex_wait(int*, int);
+int futex_wake(int*, int);
+int spawn(char*, char**, int*, int);
+int nanosleep(struct timespec*);
+int clock_gettime(struct timespec*);
+int ring_setup(struct ring*, int);
+int ring_enter(void);
+int poll(struct pollfd*, int, int);
+int fcntl(int, int, int);
+int splice(int, int, int);
+int tee(int, int, int);
+int copy_file_range(int, int, int);
+int lockstat(struct lockstat*, int, int);
+int prof(int, struct profsample*, int);
+int perfstat(struct perfstat*, int);
+int trace(int, struct traceevent*, int);
+int sysstat(struct sysstat*, int, int);
+int procstat(struct procstat*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -40,3 +72,26 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+struct mutex { int state; };
+struct cond { int seq; };
+void mutex_init(struct mutex*);
+void mutex_lock(struct mutex*);
+void mutex_unlock(struct mutex*);
+void cond_init(struct cond*);
+void cond_wait(struct cond*, struct mutex*);
+void cond_signal(struct cond*);
+void cond_broadcast(struct cond*);
+int vdso_uptime(void);
+int vdso_getpid(void);
+int vdso_clock_gettime(struct timespec*);
+
+// ring.c
+int ring_init(struct ring*, int);
+int ring_queue(struct ring*, int, int, void*, int, uint64);
+int ring_submit(struct ring*);
+int ring_reap(struct ring*, struct cqe*);
+int ring_wait(struct ring*, struct cqe*);
+
+// thread.c
+int thread_create(void(*)(void*), void*);
+int thread_join(int);
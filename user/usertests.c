@@ -7,6 +7,17 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/date.h"
+#include "kernel/ring.h"
+#include "kernel/poll.h"
+#include "kernel/lockstat.h"
+#include "kernel/prof.h"
+#include "kernel/spinlock.h"
+#include "kernel/proc.h"
+#include "kernel/perf.h"
+#include "kernel/trace.h"
+#include "kernel/sysstat.h"
+#include "kernel/procstat.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -865,6 +876,1261 @@ preempt(char *s)
   wait(0);
 }
 
+// setpriority/getpriority, and inheritance of the
+// base priority across fork.
+void
+priority(char *s)
+{
+  int pid, xst;
+
+  if(setpriority(0, -1) != -1 || setpriority(0, NPRIO) != -1){
+    printf("%s: setpriority accepted a bad priority\n", s);
+    exit(1);
+  }
+  if(setpriority(0, NPRIO-1) != 0 || getpriority(0) != NPRIO-1 ||
+     getpriority(getpid()) != NPRIO-1){
+    printf("%s: setpriority/getpriority mismatch\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0)
+    exit(getpriority(0) == NPRIO-1 ? 0 : 1);
+  wait(&xst);
+  if(xst != 0){
+    printf("%s: child did not inherit priority\n", s);
+    exit(1);
+  }
+  if(setpriority(0, 0) != 0 || getpriority(0) != 0){
+    printf("%s: could not raise priority\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+// threads made by clone() share memory and open files.
+int cloneshared;
+int clonefd;
+
+void
+cloneadd(void *arg)
+{
+  __sync_fetch_and_add(&cloneshared, (int)(uint64)arg);
+}
+
+void
+cloneopen(void *arg)
+{
+  clonefd = open("clonefile", O_CREATE|O_RDWR);
+}
+
+void
+clonetest(char *s)
+{
+  int tids[4];
+  struct stat st;
+
+  for(int i = 0; i < 4; i++){
+    if((tids[i] = thread_create(cloneadd, (void*)(uint64)(i+1))) < 0){
+      printf("%s: thread_create failed\n", s);
+      exit(1);
+    }
+  }
+  for(int i = 0; i < 4; i++){
+    if(thread_join(tids[i]) != tids[i]){
+      printf("%s: thread_join failed\n", s);
+      exit(1);
+    }
+  }
+  if(cloneshared != 1+2+3+4){
+    printf("%s: threads do not share memory\n", s);
+    exit(1);
+  }
+  if(thread_join(tids[0]) != -1){
+    printf("%s: joined a thread twice\n", s);
+    exit(1);
+  }
+
+  clonefd = -1;
+  if(thread_join(thread_create(cloneopen, 0)) < 0 || clonefd < 0){
+    printf("%s: thread could not open a file\n", s);
+    exit(1);
+  }
+  if(fstat(clonefd, &st) < 0){
+    printf("%s: threads do not share open files\n", s);
+    exit(1);
+  }
+  close(clonefd);
+  unlink("clonefile");
+  exit(0);
+}
+
+// while another thread runs, sbrk() may grow memory but
+// not shrink it; once the thread is joined it may again.
+int clonepipe[2];
+char *clonemem;
+
+void
+clonetouch(void *arg)
+{
+  char c;
+
+  read(clonepipe[0], &c, 1);
+  clonemem[0] = c;
+}
+
+void
+clonesbrk(char *s)
+{
+  char *a;
+  int tid;
+
+  if(pipe(clonepipe) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if((tid = thread_create(clonetouch, 0)) < 0){
+    printf("%s: thread_create failed\n", s);
+    exit(1);
+  }
+  if((a = sbrk(2*4096)) == (char*)-1){
+    printf("%s: sbrk could not grow with a thread running\n", s);
+    exit(1);
+  }
+  clonemem = a + 4096;
+  if(sbrk(-4096) != (char*)-1){
+    printf("%s: sbrk shrank with a thread running\n", s);
+    exit(1);
+  }
+  write(clonepipe[1], "x", 1);
+  thread_join(tid);
+  if(clonemem[0] != 'x'){
+    printf("%s: thread did not see the grown memory\n", s);
+    exit(1);
+  }
+  if(sbrk(-2*4096) == (char*)-1){
+    printf("%s: sbrk could not shrink after join\n", s);
+    exit(1);
+  }
+  close(clonepipe[0]);
+  close(clonepipe[1]);
+  exit(0);
+}
+
+// kill() ends every thread of a process, and wait() returns
+// only once they have all exited.
+int killpipe[2];
+
+void
+clonesleep(void *arg)
+{
+  char c;
+
+  read(killpipe[0], &c, 1);
+}
+
+void
+clonekill(char *s)
+{
+  int pid, out[2];
+  char c;
+
+  if(pipe(out) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if((pid = fork()) < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    close(out[0]);
+    if(pipe(killpipe) < 0 || thread_create(clonesleep, 0) < 0)
+      exit(1);
+    write(out[1], "x", 1);
+    clonesleep(0);
+    exit(0);
+  }
+  close(out[1]);
+  if(read(out[0], &c, 1) != 1){
+    printf("%s: child did not start its thread\n", s);
+    exit(1);
+  }
+  kill(pid);
+  wait(0);
+  // the group closes its files when its last thread exits.
+  if(read(out[0], &c, 1) != 0){
+    printf("%s: a thread outlived its killed process\n", s);
+    exit(1);
+  }
+  close(out[0]);
+  exit(0);
+}
+
+struct mutex futexmutex;
+struct cond futexcond;
+int futexready, futexcount;
+
+void
+futexworker(void *arg)
+{
+  mutex_lock(&futexmutex);
+  while(!futexready)
+    cond_wait(&futexcond, &futexmutex);
+  mutex_unlock(&futexmutex);
+  for(int i = 0; i < 1000; i++){
+    mutex_lock(&futexmutex);
+    futexcount++;
+    mutex_unlock(&futexmutex);
+  }
+}
+
+// futex-based mutexes and condition variables.
+void
+futextest(char *s)
+{
+  int tids[4];
+  int x = 1;
+
+  if(futex_wait(&x, 2) != -1){
+    printf("%s: futex_wait slept on a changed value\n", s);
+    exit(1);
+  }
+  if(futex_wait((int*)0xfffffffff0, 0) != -1 || futex_wake(&x, 1) != 0){
+    printf("%s: bad futex result\n", s);
+    exit(1);
+  }
+
+  mutex_init(&futexmutex);
+  cond_init(&futexcond);
+  for(int i = 0; i < 4; i++){
+    if((tids[i] = thread_create(futexworker, 0)) < 0){
+      printf("%s: thread_create failed\n", s);
+      exit(1);
+    }
+  }
+  sleep(1);
+  mutex_lock(&futexmutex);
+  futexready = 1;
+  cond_broadcast(&futexcond);
+  mutex_unlock(&futexmutex);
+  for(int i = 0; i < 4; i++)
+    thread_join(tids[i]);
+  if(futexcount != 4*1000){
+    printf("%s: count %d, expected %d\n", s, futexcount, 4*1000);
+    exit(1);
+  }
+  exit(0);
+}
+
+// a futex is the int's memory, not its address: a forked child
+// waiting on its copy of an int is not woken through the
+// parent's copy at the same address.
+int futexshared;
+
+void
+futexfork(char *s)
+{
+  int pid, fds[2];
+  char c;
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if((pid = fork()) < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    write(fds[1], "x", 1);
+    futex_wait(&futexshared, 0);
+    exit(0);
+  }
+  if(read(fds[0], &c, 1) != 1){
+    printf("%s: child did not start\n", s);
+    exit(1);
+  }
+  sleep(1);
+  if(futex_wake(&futexshared, 1) != 0){
+    printf("%s: woke a waiter in another address space\n", s);
+    exit(1);
+  }
+  kill(pid);
+  wait(0);
+  close(fds[0]);
+  close(fds[1]);
+  exit(0);
+}
+
+// spawn() a program with its output redirected to a pipe.
+void
+spawntest(char *s)
+{
+  int fds[2], xst;
+  char buf[16];
+  char *args[] = { "echo", "spawned", 0 };
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  int map[3] = { 0, fds[1], 2 };
+  int pid = spawn("echo", args, map, 3);
+  if(pid < 0){
+    printf("%s: spawn failed\n", s);
+    exit(1);
+  }
+  close(fds[1]);
+  // echo's output goes to the pipe; the child must not have
+  // inherited the read end, or anything beyond fds 0..2.
+  int n = 0, cc;
+  while((cc = read(fds[0], buf+n, sizeof(buf)-1-n)) > 0)
+    n += cc;
+  close(fds[0]);
+  buf[n] = 0;
+  if(wait(&xst) != pid || xst != 0){
+    printf("%s: wait for spawned child failed\n", s);
+    exit(1);
+  }
+  if(strcmp(buf, "spawned\n") != 0){
+    printf("%s: wrong output: %s\n", s, buf);
+    exit(1);
+  }
+
+  // a failed spawn must give back the files it took.
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  map[1] = fds[1];
+  if(spawn("nonexistent", args, map, 3) != -1){
+    printf("%s: spawn of a missing file succeeded\n", s);
+    exit(1);
+  }
+  close(fds[1]);
+  if(read(fds[0], buf, 1) != 0){
+    printf("%s: failed spawn kept a file open\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  map[1] = 100;
+  if(spawn("echo", args, map, 3) != -1){
+    printf("%s: spawn with a bad fd succeeded\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+// nanosleep() sleeps for at least as long as asked,
+// at much finer grain than a clock tick.
+void
+nanotest(char *s)
+{
+  struct timespec t0, t1, req;
+  uint64 ns;
+
+  for(int i = 0; i < 10; i++){
+    req.sec = 0;
+    req.nsec = 2000000;  // 2ms
+    if(clock_gettime(&t0) < 0 || nanosleep(&req) < 0 || clock_gettime(&t1) < 0){
+      printf("%s: nanosleep or clock_gettime failed\n", s);
+      exit(1);
+    }
+    ns = (t1.sec - t0.sec) * 1000000000 + t1.nsec - t0.nsec;
+    if(ns < req.nsec){
+      printf("%s: slept %d ns, less than %d\n", s, (int)ns, (int)req.nsec);
+      exit(1);
+    }
+    if(ns > 50000000){
+      printf("%s: slept %d ns for a 2ms nanosleep\n", s, (int)ns);
+      exit(1);
+    }
+  }
+
+  req.sec = 0;
+  req.nsec = 1000000000;
+  if(nanosleep(&req) != -1){
+    printf("%s: nanosleep accepted a bad nsec\n", s);
+    exit(1);
+  }
+  req.sec = -1;
+  req.nsec = 0;
+  if(nanosleep(&req) != -1){
+    printf("%s: nanosleep accepted a negative sec\n", s);
+    exit(1);
+  }
+
+  // a sleep too long to count in timer cycles must not
+  // wrap around into one that ends at once.
+  int pid, xstate;
+  if((pid = fork()) < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    req.sec = 1L << 62;
+    nanosleep(&req);
+    exit(0);
+  }
+  sleep(2);
+  kill(pid);
+  wait(&xstate);
+  if(xstate != -1){
+    printf("%s: a huge nanosleep ended early\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+// the VDSO pages agree with the system calls, and are read-only.
+void
+vdsotest(char *s)
+{
+  struct timespec t0, t1;
+  int fd, pid, xst;
+
+  if(vdso_getpid() != getpid()){
+    printf("%s: vdso pid %d, getpid %d\n", s, vdso_getpid(), getpid());
+    exit(1);
+  }
+  int u = uptime();
+  int v = vdso_uptime();
+  if(v < u || v > u + 1){
+    printf("%s: vdso uptime %d, uptime %d\n", s, v, u);
+    exit(1);
+  }
+  clock_gettime(&t0);
+  vdso_clock_gettime(&t1);
+  if(t1.sec < t0.sec || (t1.sec == t0.sec && t1.nsec < t0.nsec)){
+    printf("%s: vdso clock went backwards\n", s);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(vdso_getpid() != getpid())
+      exit(2);
+    *(int *)VDSO = 0;
+    exit(0);
+  }
+  wait(&xst);
+  if(xst != -1){
+    printf("%s: child could write the vdso page (%d)\n", s, xst);
+    exit(1);
+  }
+
+  // the kernel must not write it on a process's behalf, either.
+  if((fd = open("README", 0)) < 0){
+    printf("%s: open README failed\n", s);
+    exit(1);
+  }
+  if(read(fd, (char *)VDSO, 8) != -1){
+    printf("%s: read() into the vdso page succeeded\n", s);
+    exit(1);
+  }
+  close(fd);
+  exit(0);
+}
+
+// write and read a file through a submission ring.
+void
+ringfile(char *s, int flags)
+{
+  struct ring *r;
+  struct cqe c;
+  char buf[16];
+  int fd;
+
+  if((r = malloc(sizeof(*r))) == 0 || ring_init(r, flags) < 0){
+    printf("%s: ring_init failed\n", s);
+    exit(1);
+  }
+  if((fd = open("ringfile", O_CREATE|O_RDWR)) < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  ring_queue(r, RING_WRITE, fd, "hello ring", 10, 1);
+  ring_queue(r, RING_NOP, 0, 0, 0, 2);
+  ring_queue(r, RING_WRITE, 100, "x", 1, 3);
+  ring_queue(r, RING_CLOSE, fd, 0, 0, 4);
+  ring_submit(r);
+  for(int i = 1; i <= 4; i++){
+    if(ring_wait(r, &c) < 0 || c.data != i){
+      printf("%s: missing completion %d\n", s, i);
+      exit(1);
+    }
+    int want = (i == 1) ? 10 : (i == 3) ? -1 : 0;
+    if(c.res != want){
+      printf("%s: completion %d: res %d, expected %d\n", s, i, c.res, want);
+      exit(1);
+    }
+  }
+
+  if((fd = open("ringfile", O_RDONLY)) < 0){
+    printf("%s: reopen failed\n", s);
+    exit(1);
+  }
+  memset(buf, 0, sizeof(buf));
+  ring_queue(r, RING_READ, fd, buf, sizeof(buf), 5);
+  ring_submit(r);
+  if(ring_wait(r, &c) < 0 || c.res != 10 || strcmp(buf, "hello ring") != 0){
+    printf("%s: ring read failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("ringfile");
+}
+
+// how many RING_SQPOLL threads exist, exited or not.
+int
+ringpollers(void)
+{
+  static struct procstat ps[NPROC];
+  int i, n, found = 0;
+
+  n = procstat(ps, NPROC);
+  for(i = 0; i < n; i++)
+    if(strcmp(ps[i].name, "ringpoll") == 0)
+      found++;
+  return found;
+}
+
+void
+ringtest(char *s)
+{
+  int pid, xst;
+
+  ringfile(s, 0);
+
+  // a process has one ring, so try the poller in a child.
+  if((pid = fork()) < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    ringfile(s, RING_SQPOLL);
+    exit(0);
+  }
+  wait(&xst);
+  if(xst != 0)
+    exit(xst);
+
+  // a poller blocked in a read of the process's own pipe
+  // must not outlive it, nor stop it from calling exec().
+  for(int i = 0; i < 2; i++){
+    if((pid = fork()) < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      struct ring *r;
+      char buf[1];
+      int fds[2];
+      if(pipe(fds) < 0 || (r = malloc(sizeof(*r))) == 0 || ring_init(r, RING_SQPOLL) < 0)
+        exit(1);
+      ring_queue(r, RING_READ, fds[0], buf, 1, 1);
+      ring_submit(r);
+      sleep(1);
+      if(i == 0)
+        exit(0);
+      char *argv[] = { "echo", 0 };
+      close(1);
+      exec("echo", argv);
+      exit(2);
+    }
+    wait(&xst);
+    if(xst != 0){
+      printf("%s: exec with a ring poller failed (%d)\n", s, xst);
+      exit(1);
+    }
+  }
+  for(int tries = 0; ringpollers() > 0; tries++){
+    if(tries == 20){
+      printf("%s: ring poller outlived its process\n", s);
+      exit(1);
+    }
+    sleep(1);
+  }
+  exit(0);
+}
+
+// poll() on pipes: readiness, timeouts, and hangup.
+void
+polltest(char *s)
+{
+  struct pollfd fds[3];
+  int a[2], b[2];
+  struct timespec t0, t1;
+
+  if(pipe(a) < 0 || pipe(b) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  fds[0].fd = a[0];
+  fds[0].events = POLLIN;
+  fds[1].fd = b[0];
+  fds[1].events = POLLIN;
+  fds[2].fd = b[1];
+  fds[2].events = POLLOUT;
+
+  // only the write end is ready.
+  if(poll(fds, 3, 0) != 1 || fds[0].revents || fds[1].revents || fds[2].revents != POLLOUT){
+    printf("%s: wrong readiness on empty pipes\n", s);
+    exit(1);
+  }
+
+  // nothing to read: a timeout.
+  clock_gettime(&t0);
+  if(poll(fds, 2, 20) != 0){
+    printf("%s: poll of empty pipes did not time out\n", s);
+    exit(1);
+  }
+  clock_gettime(&t1);
+  if((t1.sec - t0.sec) * 1000000000 + t1.nsec - t0.nsec < 20000000){
+    printf("%s: poll timed out early\n", s);
+    exit(1);
+  }
+
+  // a child writes to b while the parent waits.
+  int pid = fork();
+  if(pid == 0){
+    sleep(2);
+    write(b[1], "x", 1);
+    exit(0);
+  }
+  if(poll(fds, 2, -1) != 1 || fds[0].revents || fds[1].revents != POLLIN){
+    printf("%s: poll missed a write\n", s);
+    exit(1);
+  }
+  wait(0);
+
+  // closing the write end is a hangup.
+  close(a[1]);
+  if(poll(fds, 1, -1) != 1 || fds[0].revents != POLLHUP){
+    printf("%s: poll missed a hangup\n", s);
+    exit(1);
+  }
+
+  fds[0].fd = 100;
+  if(poll(fds, 1, 0) != 1 || fds[0].revents != POLLNVAL){
+    printf("%s: bad fd not reported\n", s);
+    exit(1);
+  }
+  close(a[0]);
+  close(b[0]);
+  close(b[1]);
+  exit(0);
+}
+
+// growing and shrinking a pipe's buffer with fcntl().
+void
+pipesize(char *s)
+{
+  int fds[2], i, n;
+  static char buf[16384];
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[0], F_GETPIPE_SZ, 0) != 4096){
+    printf("%s: wrong default size\n", s);
+    exit(1);
+  }
+  // sizes round up to a power-of-two number of pages.
+  if(fcntl(fds[1], F_SETPIPE_SZ, 10000) != 16384){
+    printf("%s: set size failed\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[1], F_SETPIPE_SZ, 1 << 30) != -1){
+    printf("%s: huge size allowed\n", s);
+    exit(1);
+  }
+
+  // a full 16K buffer takes one write without a reader.
+  for(i = 0; i < sizeof(buf); i++)
+    buf[i] = i % 251;
+  if(write(fds[1], buf, sizeof(buf)) != sizeof(buf)){
+    printf("%s: write failed\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[1], F_SETPIPE_SZ, 4096) != -1){
+    printf("%s: shrank below the buffered data\n", s);
+    exit(1);
+  }
+  // consume a little and refill, so the data wraps around.
+  if(read(fds[0], buf, 100) != 100){
+    printf("%s: read failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 100; i++)
+    buf[i] = (sizeof(buf) + i) % 251;
+  if(write(fds[1], buf, 100) != 100){
+    printf("%s: wrap write failed\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[1], F_SETPIPE_SZ, 32768) != 32768){
+    printf("%s: grow with data failed\n", s);
+    exit(1);
+  }
+  close(fds[1]);
+  memset(buf, 0, sizeof(buf));
+  for(i = 100; (n = read(fds[0], buf, sizeof(buf))) > 0; ){
+    for(int j = 0; j < n; j++, i++){
+      if(buf[j] != (char)(i % 251)){
+        printf("%s: wrong data at %d\n", s, i);
+        exit(1);
+      }
+    }
+  }
+  if(i != sizeof(buf) + 100){
+    printf("%s: read %d bytes\n", s, i);
+    exit(1);
+  }
+  close(fds[0]);
+  exit(0);
+}
+
+// splice() and tee() between files and pipes.
+void
+splicetest(char *s)
+{
+  int a[2], b[2], fd, i, n;
+  static char buf[8192];
+  char *name = "splicefile";
+
+  for(i = 0; i < sizeof(buf); i++)
+    buf[i] = i % 251;
+  unlink(name);
+  fd = open(name, O_CREATE|O_RDWR);
+  if(fd < 0 || write(fd, buf, sizeof(buf)) != sizeof(buf)){
+    printf("%s: create %s failed\n", s, name);
+    exit(1);
+  }
+  close(fd);
+  if(pipe(a) < 0 || pipe(b) < 0 ||
+     fcntl(a[0], F_SETPIPE_SZ, sizeof(buf)) < 0 || fcntl(b[0], F_SETPIPE_SZ, sizeof(buf)) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+
+  // file to pipe.
+  fd = open(name, O_RDONLY);
+  if(splice(fd, a[1], sizeof(buf)) != sizeof(buf)){
+    printf("%s: splice from file failed\n", s);
+    exit(1);
+  }
+
+  // tee copies the first half, leaving a full.
+  if(tee(a[0], b[1], 4096) != 4096){
+    printf("%s: tee failed\n", s);
+    exit(1);
+  }
+  memset(buf, 0, sizeof(buf));
+  if(read(b[0], buf, sizeof(buf)) != 4096){
+    printf("%s: short read after tee\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 4096; i++){
+    if(buf[i] != (char)(i % 251)){
+      printf("%s: wrong data after tee\n", s);
+      exit(1);
+    }
+  }
+
+  // pipe to pipe moves whole pages, then pipe to file.
+  if(splice(a[0], b[1], 4096) != 4096 || splice(a[0], b[1], 4096) != 4096){
+    printf("%s: pipe splice failed\n", s);
+    exit(1);
+  }
+  if(splice(fd, a[1], 10) != 0){
+    printf("%s: no end of file from splice\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink(name);
+  fd = open(name, O_CREATE|O_RDWR);
+  close(b[1]);
+  for(i = 0; (n = splice(b[0], fd, sizeof(buf))) > 0; i += n)
+    ;
+  close(fd);
+  if(i != sizeof(buf)){
+    printf("%s: splice to file moved %d bytes\n", s, i);
+    exit(1);
+  }
+  fd = open(name, O_RDONLY);
+  memset(buf, 0, sizeof(buf));
+  if(read(fd, buf, sizeof(buf)) != sizeof(buf)){
+    printf("%s: read back failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < sizeof(buf); i++){
+    if(buf[i] != (char)(i % 251)){
+      printf("%s: wrong data at %d\n", s, i);
+      exit(1);
+    }
+  }
+  close(fd);
+  unlink(name);
+
+  // splice needs a pipe at one end.
+  if(splice(0, 1, 1) != -1){
+    printf("%s: splice without a pipe\n", s);
+    exit(1);
+  }
+  close(a[0]);
+  close(a[1]);
+  close(b[0]);
+  exit(0);
+}
+
+// two splices the opposite ways between two full pipes must
+// not hold each other's pipes, or a reader's, hostage.
+void
+splicecross(char *s)
+{
+  int a[2], b[2], pid1, pid2, sz;
+  static char buf[4096];
+
+  if(pipe(a) < 0 || pipe(b) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  sz = fcntl(a[0], F_GETPIPE_SZ, 0);
+  if(sz <= 0 || sz > sizeof(buf) || fcntl(b[0], F_SETPIPE_SZ, sz) != sz){
+    printf("%s: pipe size %d\n", s, sz);
+    exit(1);
+  }
+  if(write(a[1], buf, sz) != sz || write(b[1], buf, sz) != sz){
+    printf("%s: fill failed\n", s);
+    exit(1);
+  }
+  if((pid1 = fork()) == 0){
+    splice(a[0], b[1], sz);
+    exit(0);
+  }
+  if((pid2 = fork()) == 0){
+    splice(b[0], a[1], sz);
+    exit(0);
+  }
+  if(pid1 < 0 || pid2 < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  sleep(1);
+  // making room in a lets both splices finish.
+  if(read(a[0], buf, sz) != sz){
+    printf("%s: read failed\n", s);
+    exit(1);
+  }
+  wait(0);
+  wait(0);
+  exit(0);
+}
+
+// copy_file_range() across several log transactions and
+// into the indirect block.
+void
+copyrange(char *s)
+{
+  int fd, fd1, i, n, p[2];
+  static char buf[20*1024];
+
+  for(i = 0; i < sizeof(buf); i++)
+    buf[i] = i % 253;
+  unlink("copyin");
+  unlink("copyout");
+  fd = open("copyin", O_CREATE|O_RDWR);
+  if(fd < 0 || write(fd, buf, sizeof(buf)) != sizeof(buf)){
+    printf("%s: create copyin failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  fd = open("copyin", O_RDONLY);
+  fd1 = open("copyout", O_CREATE|O_RDWR);
+  if(fd < 0 || fd1 < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  // skip a little, so the copy is not block aligned.
+  if(read(fd, buf, 100) != 100){
+    printf("%s: read failed\n", s);
+    exit(1);
+  }
+  if((n = copy_file_range(fd, fd1, sizeof(buf))) != sizeof(buf) - 100){
+    printf("%s: copied %d bytes\n", s, n);
+    exit(1);
+  }
+  if(copy_file_range(fd, fd1, 10) != 0){
+    printf("%s: no end of file\n", s);
+    exit(1);
+  }
+  if(pipe(p) < 0 || copy_file_range(fd, p[1], 10) != -1){
+    printf("%s: copy to a pipe\n", s);
+    exit(1);
+  }
+  close(p[0]);
+  close(p[1]);
+  close(fd);
+  close(fd1);
+
+  fd = open("copyout", O_RDONLY);
+  memset(buf, 0, sizeof(buf));
+  if(read(fd, buf, sizeof(buf)) != sizeof(buf) - 100){
+    printf("%s: copyout has the wrong size\n", s);
+    exit(1);
+  }
+  for(i = 0; i < sizeof(buf) - 100; i++){
+    if(buf[i] != (char)((i + 100) % 253)){
+      printf("%s: wrong data at %d\n", s, i);
+      exit(1);
+    }
+  }
+  close(fd);
+  unlink("copyin");
+  unlink("copyout");
+  exit(0);
+}
+
+// lockstat() reports and resets per-name lock counts.
+void
+lockstattest(char *s)
+{
+  static struct lockstat ls[NLOCKCLASS];
+  int i, n;
+  uint64 before = 0, after = -1;
+
+  n = lockstat(ls, NLOCKCLASS, 0);
+  for(i = 0; i < n; i++)
+    if(strcmp(ls[i].name, "kmem") == 0)
+      before = ls[i].nacquire;
+  if(n <= 0 || before == 0){
+    printf("%s: no kmem acquires\n", s);
+    exit(1);
+  }
+  lockstat(0, 0, 1);
+  n = lockstat(ls, NLOCKCLASS, 0);
+  for(i = 0; i < n; i++)
+    if(strcmp(ls[i].name, "kmem") == 0)
+      after = ls[i].nacquire;
+  if(after >= before){
+    printf("%s: reset did not zero the counts\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+// the profiler should catch this process spinning in user space.
+void
+proftest(char *s)
+{
+  static struct profsample ps[64];
+  int i, n, t0, mine = 0;
+
+  if(prof(PROF_START, 0, 0) < 0){
+    printf("%s: prof start failed\n", s);
+    exit(1);
+  }
+  t0 = uptime();
+  while(uptime() < t0 + 5)
+    ;
+  prof(PROF_STOP, 0, 0);
+  while((n = prof(PROF_READ, ps, 64)) > 0){
+    for(i = 0; i < n; i++){
+      if(ps[i].depth < 1 || ps[i].depth > PROFDEPTH){
+        printf("%s: bad depth %d\n", s, ps[i].depth);
+        exit(1);
+      }
+      if(ps[i].pid == getpid() && ps[i].user)
+        mine++;
+    }
+  }
+  if(n < 0 || mine == 0){
+    printf("%s: no samples of this process\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+// a child's counters should reach its parent when it is reaped.
+void
+perftest(char *s)
+{
+  struct perfstat self, before, after;
+  int pid, t0;
+
+  if(perfstat(&self, PERF_SELF) < 0 || self.instret == 0 || self.cycles == 0){
+    printf("%s: no counts for this process\n", s);
+    exit(1);
+  }
+  if(perfstat(&before, PERF_CHILDREN) < 0){
+    printf("%s: perfstat failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    t0 = uptime();
+    while(uptime() < t0 + 2)
+      ;
+    exit(0);
+  }
+  wait(0);
+  perfstat(&after, PERF_CHILDREN);
+  if(after.instret <= before.instret || after.utime <= before.utime ||
+     after.stime <= before.stime){
+    printf("%s: child's counts missing\n", s);
+    exit(1);
+  }
+  if(perfstat(&self, 2) != -1){
+    printf("%s: bad who accepted\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+// tracepoints should record this process's system calls.
+void
+tracetest(char *s)
+{
+  static struct traceevent ev[64];
+  int i, n, enter = 0, exit_ = 0;
+
+  if(trace(TRACE_START, 0, 0) < 0){
+    printf("%s: trace start failed\n", s);
+    exit(1);
+  }
+  getpid();
+  trace(TRACE_STOP, 0, 0);
+  while((n = trace(TRACE_READ, ev, 64)) > 0){
+    for(i = 0; i < n; i++){
+      if(ev[i].pid != getpid() || ev[i].arg[0] != SYS_getpid)
+        continue;
+      if(ev[i].type == TR_SYSENTER)
+        enter++;
+      if(ev[i].type == TR_SYSEXIT && ev[i].arg[1] == getpid())
+        exit_++;
+    }
+  }
+  if(n < 0 || enter != 1 || exit_ != 1){
+    printf("%s: getpid traced %d/%d times\n", s, enter, exit_);
+    exit(1);
+  }
+  exit(0);
+}
+
+// getpid() calls should show up in its counts, and a
+// reset should zero them.
+void
+sysstattest(char *s)
+{
+  static struct sysstat ss[64];
+  struct sysstat *g;
+  int i, n;
+  uint64 hist = 0;
+
+  if((n = sysstat(ss, 64, 1)) < SYS_getpid){
+    printf("%s: sysstat returned %d\n", s, n);
+    exit(1);
+  }
+  for(i = 0; i < 10; i++)
+    getpid();
+  sysstat(ss, 64, 0);
+  g = &ss[SYS_getpid-1];
+  for(i = 0; i < NSYSHIST; i++)
+    hist += g->hist[i];
+  if(strcmp(g->name, "getpid") != 0 || g->ncall < 10 || hist != g->ncall){
+    printf("%s: %s called %d times, %d in histogram\n", s, g->name,
+           (int)g->ncall, (int)hist);
+    exit(1);
+  }
+  exit(0);
+}
+
+// procstat() should list this process, with the pipe bytes
+// it moved and the times it slept.
+void
+procstattest(char *s)
+{
+  static struct procstat ps[NPROC];
+  struct procstat *me = 0;
+  char buf[100];
+  int fds[2], i, n;
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  memset(buf, 'x', sizeof(buf));
+  if(write(fds[1], buf, sizeof(buf)) != sizeof(buf) ||
+     read(fds[0], buf, sizeof(buf)) != sizeof(buf)){
+    printf("%s: pipe i/o failed\n", s);
+    exit(1);
+  }
+  sleep(1);
+  n = procstat(ps, NPROC);
+  for(i = 0; i < n; i++)
+    if(ps[i].pid == getpid())
+      me = &ps[i];
+  if(me == 0 || strcmp(me->name, "usertests") != 0){
+    printf("%s: not in procstat\n", s);
+    exit(1);
+  }
+  if(me->use.npipewrite < sizeof(buf) || me->use.npiperead < sizeof(buf) ||
+     me->use.nvcsw == 0 || me->ppid == 0 || me->sz == 0){
+    printf("%s: wrong counts\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+// mix eleven values, making system calls between the
+// steps if calls is set, and every so often blocking in a
+// read of fd, if it is not -1, and in sleep(). the compiler
+// keeps the values in callee-saved s registers, since they
+// live across calls.
+static uint64
+regmix(int calls, int fd)
+{
+  uint64 r0 = 1, r1 = 2, r2 = 3, r3 = 4, r4 = 5, r5 = 6;
+  uint64 r6 = 7, r7 = 8, r8 = 9, r9 = 10, r10 = 11;
+  char c;
+
+  for(int i = 0; i < 1000; i++){
+    if(calls)
+      getpid();
+    r0 += r1; r1 += r2; r2 += r3; r3 += r4; r4 += r5; r5 += r6;
+    r6 += r7; r7 += r8; r8 += r9; r9 += r10; r10 += 1;
+    if(calls)
+      uptime();
+    if(calls && fd >= 0 && i % 100 == 0)
+      read(fd, &c, 1);
+    if(calls && fd >= 0 && i % 100 == 50)
+      sleep(1);
+  }
+  return r0 + r1 + r2 + r3 + r4 + r5 + r6 + r7 + r8 + r9 + r10;
+}
+
+// a system call must keep the callee-saved registers, on
+// the fast path too, where the kernel does not save them;
+// and also when the call sleeps, and perhaps wakes up on
+// another CPU.
+void
+fastcallregs(char *s)
+{
+  int fds[2], pid;
+
+  if(regmix(1, -1) != regmix(0, -1)){
+    printf("%s: registers changed across system calls\n", s);
+    exit(1);
+  }
+
+  // a child feeds the pipe slowly, so that most reads of
+  // it wait.
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if((pid = fork()) < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[0]);
+    for(int i = 0; i < 10; i++){
+      sleep(1);
+      write(fds[1], "x", 1);
+    }
+    exit(0);
+  }
+  close(fds[1]);
+  if(regmix(1, fds[0]) != regmix(0, -1)){
+    printf("%s: registers changed across blocking system calls\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  wait(0);
+  exit(0);
+}
+
+// lock-free inode and pid lookups racing with the entries
+// being freed and recycled: more files than the inode table
+// holds, and kill() of processes that are exiting.
+void
+rcurace(char *s)
+{
+  enum { NCHILD = 4, N = 100 };
+  char name[8];
+  int i, c, fd, pid, xst;
+
+  for(c = 0; c < NCHILD; c++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      name[0] = 'r';
+      name[1] = '0' + c;
+      name[3] = 0;
+      for(i = 0; i < N; i++){
+        name[2] = 'a' + i % 26;
+        if((fd = open(name, O_CREATE|O_RDWR)) < 0){
+          printf("%s: create %s failed\n", s, name);
+          exit(1);
+        }
+        close(fd);
+        if((fd = open(".", O_RDONLY)) < 0){
+          printf("%s: open . failed\n", s);
+          exit(1);
+        }
+        close(fd);
+        unlink(name);
+      }
+      exit(0);
+    }
+  }
+
+  // meanwhile, another child kills its own children as they exit.
+  if(fork() == 0){
+    for(i = 0; i < N; i++){
+      pid = fork();
+      if(pid < 0){
+        printf("%s: fork failed\n", s);
+        exit(1);
+      }
+      if(pid == 0)
+        exit(0);
+      kill(pid);
+      wait(0);
+      if(kill(pid) != -1){
+        printf("%s: killed a reaped pid\n", s);
+        exit(1);
+      }
+    }
+    exit(0);
+  }
+
+  for(c = 0; c < NCHILD + 1; c++){
+    wait(&xst);
+    if(xst != 0)
+      exit(xst);
+  }
+  exit(0);
+}
+
 // try to find any races between exit and wait
 void
 exitwait(char *s)
@@ -2873,6 +4139,29 @@ main(int argc, char *argv[])
     {pipe1, "pipe1"},
     {killstatus, "killstatus"},
     {preempt, "preempt"},
+    {priority, "priority"},
+    {clonetest, "clonetest"},
+    {clonesbrk, "clonesbrk"},
+    {clonekill, "clonekill"},
+    {futextest, "futextest"},
+    {futexfork, "futexfork"},
+    {spawntest, "spawntest"},
+    {nanotest, "nanotest"},
+    {vdsotest, "vdsotest"},
+    {ringtest, "ringtest"},
+    {polltest, "polltest"},
+    {pipesize, "pipesize"},
+    {splicetest, "splicetest"},
+    {splicecross, "splicecross"},
+    {copyrange, "copyrange"},
+    {lockstattest, "lockstattest"},
+    {proftest, "proftest"},
+    {perftest, "perftest"},
+    {tracetest, "tracetest"},
+    {sysstattest, "sysstattest"},
+    {procstattest, "procstattest"},
+    {fastcallregs, "fastcallregs"},
+    {rcurace, "rcurace"},
     {exitwait, "exitwait"},
     {rmdot, "rmdot"},
     {fourteen, "fourteen"},
@@ -36,3 +36,25 @@ entry("getpid");
 entry("sbrk");
 entry("sleep");
 entry("uptime");
+entry("setpriority");
+entry("getpriority");
+entry("clone");
+entry("join");
+entry("futex_wait");
+entry("futex_wake");
+entry("spawn");
+entry("nanosleep");
+entry("clock_gettime");
+entry("ring_setup");
+entry("ring_enter");
+entry("poll");
+entry("fcntl");
+entry("splice");
+entry("tee");
+entry("copy_file_range");
+entry("lockstat");
+entry("prof");
+entry("perfstat");
+entry("trace");
+entry("sysstat");
+entry("procstat");
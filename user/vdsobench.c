@@ -0,0 +1,74 @@
+// compare the cost of reading the time and pid with
+// system calls against reading them from the VDSO pages.
+//
+// usage: vdsobench [iters]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/date.h"
+#include "user/user.h"
+
+uint64
+nsnow(void)
+{
+  struct timespec ts;
+
+  vdso_clock_gettime(&ts);
+  return ts.sec * 1000000000 + ts.nsec;
+}
+
+void
+report(char *name, uint64 t0, int iters)
+{
+  uint64 ns = nsnow() - t0;
+
+  printf("vdsobench: %s: %d ns per call\n", name, (int)(ns / iters));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int iters = 100000;
+  struct timespec ts;
+  uint64 t0;
+  volatile int sink = 0;
+
+  if(argc > 1)
+    iters = atoi(argv[1]);
+  if(iters < 1){
+    fprintf(2, "usage: vdsobench [iters]\n");
+    exit(1);
+  }
+
+  t0 = nsnow();
+  for(int i = 0; i < iters; i++)
+    sink += uptime();
+  report("uptime", t0, iters);
+
+  t0 = nsnow();
+  for(int i = 0; i < iters; i++)
+    sink += vdso_uptime();
+  report("vdso_uptime", t0, iters);
+
+  t0 = nsnow();
+  for(int i = 0; i < iters; i++)
+    sink += getpid();
+  report("getpid", t0, iters);
+
+  t0 = nsnow();
+  for(int i = 0; i < iters; i++)
+    sink += vdso_getpid();
+  report("vdso_getpid", t0, iters);
+
+  t0 = nsnow();
+  for(int i = 0; i < iters; i++)
+    sink += clock_gettime(&ts);
+  report("clock_gettime", t0, iters);
+
+  t0 = nsnow();
+  for(int i = 0; i < iters; i++)
+    sink += vdso_clock_gettime(&ts);
+  report("vdso_clock_gettime", t0, iters);
+
+  exit(0);
+}
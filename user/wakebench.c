@@ -0,0 +1,75 @@
+// sleep/wakeup benchmark: many pairs of processes
+// bounce a byte back and forth over a pair of pipes,
+// so that most of the time is spent in sleep() and wakeup().
+//
+// usage: wakebench [npairs [rounds]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+void
+pingpong(int rfd, int wfd, int rounds, int first)
+{
+  char c = 'x';
+
+  for(int i = 0; i < rounds; i++){
+    if(first && write(wfd, &c, 1) != 1)
+      exit(1);
+    if(read(rfd, &c, 1) != 1)
+      exit(1);
+    if(!first && write(wfd, &c, 1) != 1)
+      exit(1);
+  }
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int npairs = 16, rounds = 500;
+  int i, xst, fail = 0;
+
+  if(argc > 1)
+    npairs = atoi(argv[1]);
+  if(argc > 2)
+    rounds = atoi(argv[2]);
+  if(npairs < 1 || 2*npairs > NPROC-4 || rounds < 1){
+    fprintf(2, "usage: wakebench [npairs [rounds]]\n");
+    exit(1);
+  }
+
+  int start = uptime();
+
+  for(i = 0; i < npairs; i++){
+    int a[2], b[2];
+    if(pipe(a) < 0 || pipe(b) < 0){
+      fprintf(2, "wakebench: pipe failed\n");
+      exit(1);
+    }
+    if(fork() == 0)
+      pingpong(a[0], b[1], rounds, 1);
+    if(fork() == 0)
+      pingpong(b[0], a[1], rounds, 0);
+    close(a[0]);
+    close(a[1]);
+    close(b[0]);
+    close(b[1]);
+  }
+
+  for(i = 0; i < 2*npairs; i++){
+    wait(&xst);
+    if(xst != 0)
+      fail = 1;
+  }
+
+  int t = uptime() - start;
+  if(fail){
+    printf("wakebench: a pair failed\n");
+    exit(1);
+  }
+  printf("wakebench: %d pairs x %d round trips in %d ticks\n",
+         npairs, rounds, t);
+  exit(0);
+}
@@ -7,7 +7,8 @@ int main(int argc, char **argv)
   if(argc < 2)
     exit(0);
 
-  int cnt, i, pid;
+  int cnt, i;
+  int stdfds[3] = {0, 1, 2};
   char buf[BUF_SIZE], *args[MAXARG+1], *p;
   p = buf;
   while(0 != (cnt = read(0, p, BUF_SIZE)))
@@ -41,13 +42,8 @@ int main(int argc, char **argv)
     // for(i = 0; i <= cnt; ++i)
     //   printf("%s\n", args[i]);
 
-    pid = fork();
-    if(pid == 0)
-    {
-      exec(args[0], args);
+    if(spawn(args[0], args, stdfds, 3) < 0)
       printf("exec failed\n");
-      exit(-1);
-    }
     p = buf;
   }
   while(-1 != wait(0));